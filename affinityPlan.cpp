@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include "affinityPlan.h"
+#include "cpuInfox86.h"
+#include "cpuTopologyx86.h"
+#include "cpuid.h"
+#include "threadAffinity.h"
+
+/* Placement of processor in the hierarchy of sharing domains. */
+
+struct AffinityNode
+{
+    uint32_t processor;
+    uint32_t packageId;
+    uint32_t cacheDomainId;     // Last level cache
+    uint32_t coreKey;           // Unique within system
+    uint32_t smtRank;           // Order of logical processor within its core
+    x86CoreType coreType;
+};
+
+static uint32_t ceilLog2(uint32_t value) noexcept
+{
+    uint32_t shift = 0;
+    while ((1u << shift) < value)
+        ++shift;
+    return shift;
+}
+
+static uint32_t getLastLevelCacheShift() noexcept
+{   // Logical processors sharing cache have equal APIC ID bits above the shift
+    const x86ProcessorInfo& info = queryProcessorInfo(x86SectionVendor | x86SectionCaches);
+    for (uint32_t level = 4; level > 1; --level)
+    {
+        x86CacheLevelInfo cache;
+        if (getDataCacheLevel(info, level, cache))
+            return cache.sharingLogicalProcessors ? ceilLog2(cache.sharingLogicalProcessors) : ~0u;
+    }
+    return ~0u;
+}
+
+static std::vector<AffinityNode> readAffinityNodes()
+{
+    const x86ProcessorTopology topology = getProcessorTopology();
+    const uint32_t cacheShift = getLastLevelCacheShift();
+    std::vector<AffinityNode> nodes;
+    for (const auto& cpu: topology.processors)
+    {
+        if (!cpu.valid)
+            continue;
+        AffinityNode node;
+        node.processor = cpu.processor;
+        node.packageId = cpu.packageId;
+        node.coreKey = ((uint32_t)cpu.packageId << 16) | cpu.coreId;
+        // Unknown sharing falls back to die
+        node.cacheDomainId = (cacheShift < 32) ? cpu.x2ApicId >> cacheShift :
+            ((uint32_t)cpu.packageId << 16) | cpu.dieId;
+        node.smtRank = 0;
+        node.coreType = topology.hybrid ? cpu.coreType : x86CoreType::Unknown;
+        nodes.push_back(node);
+    }
+    if (nodes.empty())
+    {   // Topology is not available, treat processor 0 as single core system
+        nodes.push_back(AffinityNode{0, 0, 0, 0, 0, x86CoreType::Unknown});
+    }
+    // SMT IDs may be sparse, rank siblings by processor index instead
+    std::sort(nodes.begin(), nodes.end(),
+        [](const AffinityNode& a, const AffinityNode& b)
+        {
+            return std::tie(a.coreKey, a.processor) < std::tie(b.coreKey, b.processor);
+        });
+    for (size_t i = 1; i < nodes.size(); ++i)
+    {
+        if (nodes[i].coreKey == nodes[i - 1].coreKey)
+            nodes[i].smtRank = nodes[i - 1].smtRank + 1;
+    }
+    return nodes;
+}
+
+static const std::vector<AffinityNode>& getAffinityNodes()
+{   // Threads are placed on this host, so that its cache sharing is read even under replay
+    static const std::vector<AffinityNode> nodes = []()
+    {
+        CpuIdHostScope host;
+        return readAffinityNodes();
+    }();
+    return nodes;
+}
+
+static std::vector<uint32_t> orderProcessors(x86AffinityPolicy policy)
+{
+    const std::vector<AffinityNode>& cachedNodes = getAffinityNodes();
+    std::vector<AffinityNode> nodes = cachedNodes;
+    switch (policy)
+    {
+    case x86AffinityPolicy::OnePerCore:
+        nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+            [](const AffinityNode& node) { return node.smtRank > 0; }), nodes.end());
+        break;
+    case x86AffinityPolicy::FillCacheDomain:
+        std::sort(nodes.begin(), nodes.end(),
+            [](const AffinityNode& a, const AffinityNode& b)
+            {
+                return std::tie(a.cacheDomainId, a.smtRank, a.coreKey, a.processor) <
+                    std::tie(b.cacheDomainId, b.smtRank, b.coreKey, b.processor);
+            });
+        break;
+    case x86AffinityPolicy::PerformanceCores:
+    case x86AffinityPolicy::EfficientCores:
+        {   // Other class is left out only if the requested one exists
+            const x86CoreType type = (x86AffinityPolicy::PerformanceCores == policy) ?
+                x86CoreType::Performance : x86CoreType::Efficient;
+            const auto end = std::remove_if(nodes.begin(), nodes.end(),
+                [type](const AffinityNode& node) { return node.coreType != type; });
+            if (end != nodes.begin())
+                nodes.erase(end, nodes.end());
+            else
+                nodes = cachedNodes;
+        }
+        // Fall through
+    case x86AffinityPolicy::AvoidSmt:
+        std::sort(nodes.begin(), nodes.end(),
+            [](const AffinityNode& a, const AffinityNode& b)
+            {
+                return std::tie(a.smtRank, a.coreKey, a.processor) <
+                    std::tie(b.smtRank, b.coreKey, b.processor);
+            });
+        break;
+    case x86AffinityPolicy::SpreadPackages:
+        {   // Interleave per-package orders
+            std::map<uint32_t, std::vector<AffinityNode>> packages;
+            std::sort(nodes.begin(), nodes.end(),
+                [](const AffinityNode& a, const AffinityNode& b)
+                {
+                    return std::tie(a.smtRank, a.cacheDomainId, a.coreKey, a.processor) <
+                        std::tie(b.smtRank, b.cacheDomainId, b.coreKey, b.processor);
+                });
+            for (const auto& node: nodes)
+                packages[node.packageId].push_back(node);
+            nodes.clear();
+            for (size_t i = 0; nodes.size() < cachedNodes.size(); ++i)
+            {
+                for (const auto& it: packages)
+                {
+                    if (i < it.second.size())
+                        nodes.push_back(it.second[i]);
+                }
+            }
+        }
+        break;
+    }
+    std::vector<uint32_t> processors;
+    for (const auto& node: nodes)
+        processors.push_back(node.processor);
+    return processors;
+}
+
+const x86AffinityPlan& getAffinityPlan(x86AffinityPolicy policy, uint32_t numThreads)
+{
+    static std::map<std::pair<x86AffinityPolicy, uint32_t>, x86AffinityPlan> plans;
+    static std::mutex plansMutex;
+    std::lock_guard<std::mutex> lock(plansMutex);
+    const auto key = std::make_pair(policy, numThreads);
+    auto it = plans.find(key);
+    if (it != plans.end())
+        return it->second;
+    x86AffinityPlan plan;
+    plan.policy = policy;
+    const std::vector<uint32_t> order = orderProcessors(policy);
+    const uint32_t count = numThreads ? numThreads : (uint32_t)order.size();
+    for (uint32_t i = 0; i < count; ++i)
+        plan.processors.push_back(order[i % order.size()]);
+    // References to map elements stay valid on insertion
+    return plans.emplace(key, std::move(plan)).first->second;
+}
+
+bool applyAffinityPlan(const x86AffinityPlan& plan, uint32_t thread) noexcept
+{
+    if (plan.processors.empty())
+        return false;
+    return setThreadAffinity(plan.processors[thread % plan.processors.size()]);
+}
+
+const char *stringifyAffinityPolicy(x86AffinityPolicy policy) noexcept
+{
+    switch (policy)
+    {
+    case x86AffinityPolicy::OnePerCore: return "One per core";
+    case x86AffinityPolicy::FillCacheDomain: return "Fill cache domain";
+    case x86AffinityPolicy::AvoidSmt: return "Avoid SMT";
+    case x86AffinityPolicy::SpreadPackages: return "Spread packages";
+    case x86AffinityPolicy::PerformanceCores: return "Performance cores";
+    case x86AffinityPolicy::EfficientCores: return "Efficient cores";
+    default: return "Unknown";
+    }
+}
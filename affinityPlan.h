@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/* Placement policies for thread pools.
+   OnePerCore - the first logical processor of every physical core,
+   FillCacheDomain - all logical processors sharing the last level cache
+       before the next domain, distinct cores first within the domain,
+   AvoidSmt - distinct physical cores first, SMT siblings after that,
+   SpreadPackages - round robin across packages, distinct cores first,
+   PerformanceCores - P-cores of hybrid processor for latency-sensitive
+       threads, distinct cores first,
+   EfficientCores - E-cores of hybrid processor for background work.
+   Without hybrid topology, or if the class has no cores, the latter two
+   are the same as AvoidSmt. */
+
+enum class x86AffinityPolicy : uint8_t
+{
+    OnePerCore, FillCacheDomain, AvoidSmt, SpreadPackages,
+    PerformanceCores, EfficientCores
+};
+
+/* Thread i of the pool should be pinned to processors[i]. Plans are
+   deterministic: the order depends on topology only, ties are broken
+   by OS logical processor index. Plans always describe this host, an
+   installed CPUID replay source is bypassed. */
+
+struct x86AffinityPlan
+{
+    x86AffinityPolicy policy;
+    std::vector<uint32_t> processors;   // OS logical processor index per thread
+};
+
+/* Plan is computed on the first request and cached. Zero number of threads
+   requests all processors of the policy, larger number than the policy
+   provides wraps around to the beginning. */
+
+const x86AffinityPlan& getAffinityPlan(x86AffinityPolicy policy, uint32_t numThreads = 0);
+bool applyAffinityPlan(const x86AffinityPlan& plan, uint32_t thread) noexcept;
+const char *stringifyAffinityPolicy(x86AffinityPolicy policy) noexcept;
@@ -1,2 +1,2 @@
 REM Run in x64 Native Tools Command Prompt
-cl /O2 /EHsc cpuInfox86.cpp waitNs.cpp main.cpp /link
+cl /O2 /EHsc cpuInfox86.cpp cpuidDump.cpp featureCatalog.cpp featureQuery.cpp isaBaseline.cpp microarchitecture.cpp cacheLine.cpp cpuDispatchx86.cpp cpuTopologyx86.cpp coreTypes.cpp coreFrequency.cpp memoryLatency.cpp memoryBandwidth.cpp memoryCopy.cpp instructionTiming.cpp coreToCoreLatency.cpp affinityPlan.cpp cacheAdvisor.cpp threadAffinity.cpp tscClock.cpp waitNs.cpp main.cpp /link
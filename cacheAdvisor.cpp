@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cmath>
+#include "cacheAdvisor.h"
+#include "cpuInfox86.h"
+#include "threadAffinity.h"
+
+#define DEFAULT_LINE_SIZE       64
+#define DEFAULT_TLB_ENTRIES     64
+
+static uint32_t floorPowerOfTwo(uint64_t value) noexcept
+{
+    uint32_t power = 1;
+    while ((power <= UINT32_MAX/2) && (power * 2ull <= value))
+        power *= 2;
+    return power;
+}
+
+static uint32_t getDataTlbEntries(const x86ProcessorInfo& info)
+{
+    for (const auto& tlb: getTlbLevels(info))
+    {
+        if ((1 == tlb.level) && (tlb.pageSizes & x86PageSize4K) &&
+            ((x86TlbType::Data == tlb.type) || (x86TlbType::Unified == tlb.type)))
+        {
+            return tlb.numEntries;
+        }
+    }
+    return DEFAULT_TLB_ENTRIES;
+}
+
+static x86CacheBlock adviseCacheBlock(const x86CacheLevelInfo& cache, uint32_t elementSize,
+    uint32_t numThreads, uint32_t numProcessors) noexcept
+{
+    x86CacheBlock block;
+    block.level = cache.level;
+    block.cacheSize = cache.size;
+    // Threads are spread over instances, but never exceed sharing count of one instance
+    const uint32_t sharing = std::max(std::min(cache.sharingLogicalProcessors, numProcessors), 1u);
+    const uint32_t numInstances = (numProcessors + sharing - 1)/sharing;
+    block.threadsPerInstance = std::min((numThreads + numInstances - 1)/numInstances, sharing);
+    uint64_t usable = cache.size;
+    if (cache.associativity > 1)
+        usable = usable/cache.associativity * (cache.associativity - 1);
+    block.blockSize = usable/block.threadsPerInstance;
+    block.numElements = block.blockSize/elementSize;
+    // Tile side is rounded down to whole lines
+    const uint32_t lineSize = cache.lineSize ? cache.lineSize : DEFAULT_LINE_SIZE;
+    const uint32_t elementsPerLine = std::max(lineSize/elementSize, 1u);
+    uint32_t tileSize = (uint32_t)std::sqrt((double)block.numElements/3.);
+    if (tileSize >= elementsPerLine)
+        tileSize -= tileSize % elementsPerLine;
+    block.tileSize = std::max(tileSize, 1u);
+    return block;
+}
+
+x86CacheAdvice getCacheAdvice(uint32_t elementSize, uint32_t numThreads)
+{
+    const x86ProcessorInfo& info = queryProcessorInfo(x86SectionVendor | x86SectionCaches);
+    const uint32_t numProcessors = std::max(getLogicalProcessorCount(), 1u);
+    x86CacheAdvice advice;
+    advice.elementSize = std::max(elementSize, 1u);
+    advice.numThreads = std::max(numThreads, 1u);
+    advice.lineSize = DEFAULT_LINE_SIZE;
+    x86CacheLevelInfo l1 = {};
+    for (uint32_t level = 1; level <= 3; ++level)
+    {
+        x86CacheLevelInfo cache;
+        if (!getDataCacheLevel(info, level, cache) || !cache.size)
+            continue;
+        if (1 == level)
+            l1 = cache;
+        if (1 == level && cache.lineSize)
+            advice.lineSize = cache.lineSize;
+        advice.blocks.push_back(adviseCacheBlock(cache, advice.elementSize,
+            advice.numThreads, numProcessors));
+    }
+    // Every partition keeps a write-combining line in L1 and its page in data TLB.
+    // Streams may take ways - 1 lines of every set, one way is left for input.
+    advice.dataTlbEntries = getDataTlbEntries(info);
+    uint64_t fanOut = advice.dataTlbEntries;
+    if (l1.size)
+    {
+        const uint64_t numLines = l1.size/advice.lineSize;
+        const uint32_t ways = l1.associativity ? l1.associativity : (uint32_t)numLines; // Fully associative
+        const uint64_t numSets = std::max<uint64_t>(numLines/std::max(ways, 1u), 1);
+        fanOut = std::min<uint64_t>(fanOut, numSets * std::max(ways - 1, 1u));
+    }
+    advice.partitionFanOut = floorPowerOfTwo(fanOut);
+    advice.radixBits = 0;
+    while ((1u << advice.radixBits) < advice.partitionFanOut)
+        ++advice.radixBits;
+    return advice;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/* Working set recommended for a data or unified cache level. Threads are
+   assumed to be spread evenly over cache instances, so that every thread
+   gets its share of the cache. One way is left for streamed data. */
+
+struct x86CacheBlock
+{
+    uint32_t level;
+    uint64_t cacheSize;             // In bytes, single instance
+    uint32_t threadsPerInstance;    // Threads which share cache instance
+    uint64_t blockSize;             // In bytes, per thread
+    uint64_t numElements;           // Per thread
+    uint32_t tileSize;              // Side of square tile in elements, three tiles fit into block
+};
+
+struct x86CacheAdvice
+{
+    uint32_t elementSize;           // In bytes
+    uint32_t numThreads;
+    uint32_t lineSize;              // In bytes
+    std::vector<x86CacheBlock> blocks;
+    uint32_t dataTlbEntries;        // First level data TLB, 4K pages, 64 if unknown
+    uint32_t partitionFanOut;       // Power of two, each partition keeps own page and L1 line hot,
+                                    // bounded by sets * (ways - 1) of L1
+    uint32_t radixBits;             // log2(partitionFanOut)
+};
+
+/* Advice is derived from CPUID reported cache hierarchy, hence it
+   doesn't require any measurement. */
+
+x86CacheAdvice getCacheAdvice(uint32_t elementSize, uint32_t numThreads = 1);
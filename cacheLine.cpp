@@ -0,0 +1,71 @@
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <cstdlib>
+#endif
+#include "cacheLine.h"
+#include "cpuInfox86.h"
+#include "cpuid.h"
+
+#define DEFAULT_LINE_SIZE   64
+
+static uint32_t readCacheLineSize() noexcept
+{
+    const x86ProcessorInfo& info = queryProcessorInfo(x86SectionFeatures | x86SectionCaches);
+    x86CacheLevelInfo cache;
+    if (getDataCacheLevel(info, 1, cache) && cache.lineSize)
+        return cache.lineSize;
+    if (info.features.cacheLineFlush && info.misc.cacheLineFlushSize)
+        return info.misc.cacheLineFlushSize * 8; // In quadwords
+    return DEFAULT_LINE_SIZE;
+}
+
+uint32_t getCacheLineSize() noexcept
+{   // Replayed processor may change, only the host is cached
+    if (getCpuIdSource())
+        return readCacheLineSize();
+    static const uint32_t lineSize = readCacheLineSize();
+    return lineSize;
+}
+
+uint32_t getCacheLinePairSize() noexcept
+{
+    return getCacheLineSize() * 2;
+}
+
+static uint32_t readFalseSharingSize() noexcept
+{   // Spatial prefetcher completes 128-byte aligned pair of lines
+    const x86VendorId vendorId = queryProcessorInfo(x86SectionVendor).vendorId;
+    const bool adjacentLinePrefetch = (x86VendorId::Intel == vendorId) ||
+        (x86VendorId::AMD == vendorId) || (x86VendorId::Hygon == vendorId);
+    return adjacentLinePrefetch ? getCacheLinePairSize() : getCacheLineSize();
+}
+
+uint32_t getFalseSharingSize() noexcept
+{
+    if (getCpuIdSource())
+        return readFalseSharingSize();
+    static const uint32_t falseSharingSize = readFalseSharingSize();
+    return falseSharingSize;
+}
+
+void *allocateAligned(size_t size, size_t alignment) noexcept
+{
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size ? size : 1))
+        return nullptr;
+    return ptr;
+#endif
+}
+
+void freeAligned(void *ptr) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
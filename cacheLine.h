@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+/* Cache line size is read from deterministic cache parameters or CLFLUSH
+   line size. Adjacent-line prefetchers of Intel and AMD processors fetch
+   lines in aligned pairs, hence false sharing size is twice the line. */
+
+uint32_t getCacheLineSize() noexcept;
+uint32_t getCacheLinePairSize() noexcept;
+uint32_t getFalseSharingSize() noexcept;
+
+void *allocateAligned(size_t size, size_t alignment) noexcept;
+void freeAligned(void *ptr) noexcept;
+
+/* Allocator which aligns storage to false sharing size selected at runtime. */
+
+template<class T>
+class CacheAlignedAllocator
+{
+public:
+    typedef T value_type;
+
+    CacheAlignedAllocator() noexcept {}
+    template<class U> CacheAlignedAllocator(const CacheAlignedAllocator<U>&) noexcept {}
+
+    T *allocate(size_t count)
+    {
+        const size_t alignment = alignof(T) > getFalseSharingSize() ? alignof(T) : getFalseSharingSize();
+        void *ptr = allocateAligned(count * sizeof(T), alignment);
+        if (!ptr)
+            throw std::bad_alloc();
+        return static_cast<T *>(ptr);
+    }
+
+    void deallocate(T *ptr, size_t) noexcept
+    {
+        freeAligned(ptr);
+    }
+
+    template<class U> bool operator==(const CacheAlignedAllocator<U>&) const noexcept { return true; }
+    template<class U> bool operator!=(const CacheAlignedAllocator<U>&) const noexcept { return false; }
+};
+
+/* Fixed size array which places every element into its own false sharing
+   unit, e.g. per-thread counters. Stride is selected at runtime. */
+
+template<class T>
+class PaddedArray
+{
+public:
+    template<class... Args>
+    explicit PaddedArray(size_t count, const Args&... args):
+        data(nullptr), count(0), stride(getPaddedSize(sizeof(T)))
+    {
+        const size_t alignment = alignof(T) > getFalseSharingSize() ? alignof(T) : getFalseSharingSize();
+        data = static_cast<char *>(allocateAligned(count * stride, alignment));
+        if (!data)
+            throw std::bad_alloc();
+        try
+        {
+            for (; this->count < count; ++this->count)
+                new (data + this->count * stride) T(args...);
+        }
+        catch (...)
+        {
+            destroy();
+            throw;
+        }
+    }
+
+    PaddedArray(PaddedArray&& other) noexcept:
+        data(other.data), count(other.count), stride(other.stride)
+    {
+        other.data = nullptr;
+        other.count = 0;
+    }
+
+    PaddedArray(const PaddedArray&) = delete;
+    PaddedArray& operator=(const PaddedArray&) = delete;
+    ~PaddedArray() { destroy(); }
+
+    T& operator[](size_t i) noexcept { return *reinterpret_cast<T *>(data + i * stride); }
+    const T& operator[](size_t i) const noexcept { return *reinterpret_cast<const T *>(data + i * stride); }
+    size_t size() const noexcept { return count; }
+    size_t getStride() const noexcept { return stride; }
+
+    static size_t getPaddedSize(size_t size) noexcept
+    {
+        const size_t unit = getFalseSharingSize();
+        return (size + unit - 1)/unit * unit;
+    }
+
+private:
+    void destroy() noexcept
+    {
+        for (size_t i = count; i > 0; --i)
+            (*this)[i - 1].~T();
+        freeAligned(data);
+        data = nullptr;
+        count = 0;
+    }
+
+    char *data;
+    size_t count;
+    size_t stride;
+};
@@ -0,0 +1,151 @@
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "coreFrequency.h"
+#include "cpuInfox86.h"
+#include "threadAffinity.h"
+#include "cpuid.h"
+
+#define IA32_MPERF      0xE7
+#define IA32_APERF      0xE8
+
+// Latency of 64-bit IMUL is 3 cycles since Intel Core and AMD K8,
+// XOR adds one cycle while SHR executes in parallel with IMUL.
+// 32-bit multiplier allows three-operand IMUL without register copy.
+#define STEP_LATENCY    4
+#define CHAIN_LENGTH    8
+#define CHAIN_STEP(x)   x = (x * 0x5BD1E995ull) ^ (x >> 29)
+
+static uint64_t runDependentChain(uint64_t iterations, uint64_t x) noexcept
+{   // Mixing multiplication with shift prevents compiler from reassociation
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        CHAIN_STEP(x); CHAIN_STEP(x); CHAIN_STEP(x); CHAIN_STEP(x);
+        CHAIN_STEP(x); CHAIN_STEP(x); CHAIN_STEP(x); CHAIN_STEP(x);
+    }
+    return x;
+}
+
+uint64_t measureCoreFrequency(uint64_t period) noexcept
+{
+    const uint64_t tscFrequency = getTscFrequency().frequency;
+    if (!tscFrequency)
+        return 0ull;
+    const uint64_t ticks = period * tscFrequency/1000000000ull;
+    constexpr uint64_t iterations = 10000;
+    uint64_t sink = 1, chains = 0;
+    // Warm up to let the core leave low power state
+    sink = runDependentChain(iterations, sink);
+    const uint64_t begin = __rdtsc();
+    uint64_t end;
+    do {
+        sink = runDependentChain(iterations, sink);
+        ++chains;
+        end = __rdtsc();
+    } while (end - begin < ticks);
+    static volatile uint64_t result;
+    result = sink;
+    (void)result;
+    const double cycles = (double)chains * iterations * CHAIN_LENGTH * STEP_LATENCY;
+    return (uint64_t)(cycles * tscFrequency/(end - begin));
+}
+
+x86CoreFrequencySampler::x86CoreFrequencySampler():
+    method(x86CoreFrequencyMethod::DependentChain)
+{
+    const x86ProcessorInfo& cpuInfo = queryProcessorInfo(x86SectionFeatures);
+    if (!getTscFrequency().frequency)
+    {
+        method = x86CoreFrequencyMethod::Unavailable;
+        return;
+    }
+#ifndef _WIN32
+    if (cpuInfo.tpmFeatures.hardwareCoordinationFeedback)
+    {   // Presence of APERF/MPERF, MSR driver requires root or CAP_SYS_RAWIO
+        const std::vector<uint32_t> processors = getLogicalProcessors();
+        msrFiles.resize(processors.back() + 1, -1);
+        for (uint32_t processor: processors)
+        {
+            char path[32];
+            snprintf(path, sizeof(path), "/dev/cpu/%u/msr", processor);
+            msrFiles[processor] = open(path, O_RDONLY);
+        }
+        uint64_t aperf, mperf;
+        if (readCounters(processors.front(), aperf, mperf))
+            method = x86CoreFrequencyMethod::AperfMperf;
+    }
+#else
+    (void)cpuInfo;
+#endif // !_WIN32
+}
+
+x86CoreFrequencySampler::~x86CoreFrequencySampler()
+{
+#ifndef _WIN32
+    for (int file: msrFiles)
+    {
+        if (file >= 0)
+            close(file);
+    }
+#endif
+}
+
+bool x86CoreFrequencySampler::readCounters(uint32_t processor,
+    uint64_t& aperf, uint64_t& mperf) const noexcept
+{
+#ifndef _WIN32
+    if (processor >= msrFiles.size() || msrFiles[processor] < 0)
+        return false;
+    return (pread(msrFiles[processor], &aperf, sizeof(uint64_t), IA32_APERF) == sizeof(uint64_t)) &&
+        (pread(msrFiles[processor], &mperf, sizeof(uint64_t), IA32_MPERF) == sizeof(uint64_t));
+#else
+    return false;
+#endif
+}
+
+std::vector<x86CoreFrequency> x86CoreFrequencySampler::sample(uint64_t period,
+    uint64_t burst /* 20000000 */)
+{
+    const std::vector<uint32_t> processors = getLogicalProcessors();
+    const size_t count = processors.size();
+    std::vector<x86CoreFrequency> frequencies(count);
+    for (size_t i = 0; i < count; ++i)
+        frequencies[i] = {processors[i], 0ull};
+    if (x86CoreFrequencyMethod::AperfMperf == method)
+    {   // Counters are read by MSR driver on the target processor
+        std::vector<uint64_t> aperf(count), mperf(count);
+        std::vector<bool> valid(count);
+        for (size_t i = 0; i < count; ++i)
+            valid[i] = readCounters(processors[i], aperf[i], mperf[i]);
+        std::this_thread::sleep_for(std::chrono::nanoseconds(period));
+        const uint64_t tscFrequency = getTscFrequency().frequency;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t aperfEnd, mperfEnd;
+            if (valid[i] && readCounters(processors[i], aperfEnd, mperfEnd) && (mperfEnd > mperf[i]))
+            {
+                const double ratio = (double)(aperfEnd - aperf[i])/(mperfEnd - mperf[i]);
+                frequencies[i].frequency = (uint64_t)(ratio * tscFrequency);
+            }
+        }
+    } else if (x86CoreFrequencyMethod::DependentChain == method)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        const uint64_t measurePeriod = burst < period ? burst : period;
+        runOnEachProcessor(
+            [&frequencies, &processors, measurePeriod](uint32_t processor, bool pinned)
+            {   // Processors are sorted, so that entry is found by id
+                const size_t i = std::lower_bound(processors.begin(), processors.end(), processor) -
+                    processors.begin();
+                if (pinned)
+                    frequencies[i].frequency = measureCoreFrequency(measurePeriod);
+            });
+        std::this_thread::sleep_until(begin + std::chrono::nanoseconds(period));
+    }
+    return frequencies;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/* Method used to measure effective core clock. */
+
+enum class x86CoreFrequencyMethod : uint8_t
+{
+    Unavailable,
+    DependentChain,     // Chain of dependent IMULs of known latency against TSC
+    AperfMperf          // Ratio of APERF/MPERF MSRs scaled by TSC frequency
+};
+
+struct x86CoreFrequency
+{
+    uint32_t processor;
+    uint64_t frequency; // In Hz, zero if processor couldn't be sampled
+};
+
+/* Effective clock of the core which executes calling thread. */
+
+uint64_t measureCoreFrequency(uint64_t period) noexcept;
+
+/* Samples effective clock of every logical processor concurrently.
+   APERF/MPERF are read through /dev/cpu/N/msr if accessible, which
+   doesn't disturb running workload. Otherwise each processor runs
+   dependent chain for at most burst nanoseconds of every period. */
+
+class x86CoreFrequencySampler
+{
+public:
+    x86CoreFrequencySampler();
+    ~x86CoreFrequencySampler();
+    x86CoreFrequencyMethod getMethod() const noexcept { return method; }
+    std::vector<x86CoreFrequency> sample(uint64_t period, uint64_t burst = 20000000ull);
+
+private:
+    bool readCounters(uint32_t processor, uint64_t& aperf, uint64_t& mperf) const noexcept;
+
+    x86CoreFrequencyMethod method;
+    std::vector<int> msrFiles;
+};
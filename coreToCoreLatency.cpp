@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include "coreToCoreLatency.h"
+#include "cpuTopologyx86.h"
+#include "cacheLine.h"
+#include "threadAffinity.h"
+
+#define NUM_REPEATS     5
+
+/* Each pair owns its own line, padded to avoid interference
+   between pairs measured in the same round. */
+
+struct PingPongLine
+{
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> ready;
+    std::atomic<bool> failed;
+
+    PingPongLine() noexcept: sequence(0), ready(0), failed(false) {}
+};
+
+static bool waitPartner(PingPongLine& line, bool pinned) noexcept
+{
+    if (!pinned)
+        line.failed.store(true, std::memory_order_relaxed);
+    line.ready.fetch_add(1, std::memory_order_acq_rel);
+    while (line.ready.load(std::memory_order_acquire) < 2)
+        std::this_thread::yield();
+    return !line.failed.load(std::memory_order_relaxed);
+}
+
+static double initiate(PingPongLine& line, uint32_t processor, uint32_t roundTrips) noexcept
+{
+    if (!waitPartner(line, setThreadAffinity(processor)))
+        return std::numeric_limits<double>::quiet_NaN();
+    double best = std::numeric_limits<double>::max();
+    uint32_t sequence = 0;
+    for (uint32_t repeat = 0; repeat < NUM_REPEATS; ++repeat)
+    {   // The first repeat warms up both cores, minimum filters out interrupts
+        const auto begin = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < roundTrips; ++i, sequence += 2)
+        {
+            while (line.sequence.load(std::memory_order_acquire) != sequence)
+                ;
+            line.sequence.store(sequence + 1, std::memory_order_release);
+        }
+        while (line.sequence.load(std::memory_order_acquire) != sequence)
+            ;
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+        best = std::min(best, elapsed.count()/roundTrips);
+    }
+    return best;
+}
+
+static void respond(PingPongLine& line, uint32_t processor, uint32_t roundTrips) noexcept
+{
+    if (!waitPartner(line, setThreadAffinity(processor)))
+        return;
+    const uint32_t count = roundTrips * NUM_REPEATS;
+    for (uint32_t i = 0, sequence = 1; i < count; ++i, sequence += 2)
+    {
+        while (line.sequence.load(std::memory_order_acquire) != sequence)
+            ;
+        line.sequence.store(sequence + 1, std::memory_order_release);
+    }
+}
+
+x86CoreToCoreLatency measureCoreToCoreLatency(uint32_t roundTrips)
+{
+    x86CoreToCoreLatency result;
+    const x86ProcessorTopology topology = getProcessorTopology();
+    std::vector<x86LogicalProcessor> processors;
+    for (const auto& cpu: topology.processors)
+    {
+        if (cpu.valid)
+            processors.push_back(cpu);
+    }
+    std::stable_sort(processors.begin(), processors.end(),
+        [](const x86LogicalProcessor& a, const x86LogicalProcessor& b)
+        {
+            if (a.packageId != b.packageId)
+                return a.packageId < b.packageId;
+            if (a.dieId != b.dieId)
+                return a.dieId < b.dieId;
+            if (a.coreId != b.coreId)
+                return a.coreId < b.coreId;
+            return a.smtId < b.smtId;
+        });
+    const uint32_t count = (uint32_t)processors.size();
+    for (const auto& cpu: processors)
+        result.processors.push_back(cpu.processor);
+    result.nanoseconds.assign((size_t)count * count, std::numeric_limits<double>::quiet_NaN());
+    for (uint32_t i = 0; i < count; ++i)
+        result.nanoseconds[(size_t)i * count + i] = 0.;
+    if (count < 2)
+        return result;
+    // Circle method: the first slot is fixed and the others rotate, odd count gets a bye slot
+    const uint32_t numSlots = count + (count & 1);
+    std::vector<uint32_t> slots(numSlots);
+    for (uint32_t i = 0; i < numSlots; ++i)
+        slots[i] = i;
+    for (uint32_t round = 0; round + 1 < numSlots; ++round)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        for (uint32_t i = 0; i < numSlots/2; ++i)
+        {
+            const uint32_t a = slots[i], b = slots[numSlots - 1 - i];
+            if ((a < count) && (b < count))
+                pairs.emplace_back(std::min(a, b), std::max(a, b));
+        }
+        PaddedArray<PingPongLine> lines(pairs.size());
+        std::vector<double> latencies(pairs.size());
+        std::vector<std::thread> workers;
+        workers.reserve(pairs.size() * 2);
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {
+            const uint32_t first = processors[pairs[i].first].processor;
+            const uint32_t second = processors[pairs[i].second].processor;
+            workers.emplace_back([&lines, &latencies, i, first, roundTrips]()
+                {
+                    latencies[i] = initiate(lines[i], first, roundTrips);
+                });
+            workers.emplace_back([&lines, i, second, roundTrips]()
+                {
+                    respond(lines[i], second, roundTrips);
+                });
+        }
+        for (auto& worker: workers)
+            worker.join();
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {   // Round trip is symmetric
+            const uint32_t a = pairs[i].first, b = pairs[i].second;
+            result.nanoseconds[(size_t)a * count + b] = latencies[i];
+            result.nanoseconds[(size_t)b * count + a] = latencies[i];
+        }
+        std::rotate(slots.begin() + 1, slots.end() - 1, slots.end());
+    }
+    return result;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/* Round trip latency of a cache line bounced between two logical
+   processors. Processors are ordered by package, die, core and SMT ID,
+   so that topology domains form blocks along the diagonal. */
+
+struct x86CoreToCoreLatency
+{
+    std::vector<uint32_t> processors;   // OS logical processor indices in matrix order
+    std::vector<double> nanoseconds;    // Row-major, N*N, NaN if pair couldn't be measured
+};
+
+/* Two threads pinned to a pair of processors take turns incrementing
+   a counter in a shared cache line. Pairs are scheduled as round-robin
+   tournament, so that every round measures disjoint pairs in parallel. */
+
+x86CoreToCoreLatency measureCoreToCoreLatency(uint32_t roundTrips = 20000);
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <set>
+#include <thread>
+#include "coreTypes.h"
+#include "coreFrequency.h"
+#include "cpuid.h"
+#include "threadAffinity.h"
+
+static void readCoreTypeInfo(x86CoreTypeInfo& coreType, bool hybrid, uint64_t period)
+{   // Runs on processor of the class, leaves describe that core
+    if (hybrid)
+    {
+        CpuId cpuId;
+        __cpuid(&cpuId.eax, 0x1A);
+        coreType.nativeModelId = (uint32_t)cpuId.eax & 0xFFFFFF;
+    }
+    const x86ProcessorInfo info = getProcessorInfo();
+    for (uint32_t level = 1; level <= 4; ++level)
+    {
+        x86CacheLevelInfo cache;
+        if (getDataCacheLevel(info, level, cache))
+            coreType.caches.push_back(cache);
+    }
+    if (period)
+        coreType.frequency = measureCoreFrequency(period);
+}
+
+std::vector<x86CoreTypeInfo> getCoreTypes(const x86ProcessorTopology& topology,
+    uint64_t period /* 20000000ull */)
+{
+    std::vector<x86CoreTypeInfo> coreTypes;
+    std::vector<std::set<uint32_t>> cores;
+    for (const auto& cpu: topology.processors)
+    {
+        if (!cpu.valid)
+            continue;
+        const x86CoreType type = topology.hybrid ? cpu.coreType : x86CoreType::Unknown;
+        auto it = std::find_if(coreTypes.begin(), coreTypes.end(),
+            [type](const x86CoreTypeInfo& coreType) { return coreType.type == type; });
+        if (it == coreTypes.end())
+        {
+            x86CoreTypeInfo coreType = {};
+            coreType.type = type;
+            coreTypes.push_back(coreType);
+            cores.emplace_back();
+            it = coreTypes.end() - 1;
+        }
+        it->processors.push_back(cpu.processor);
+        cores[it - coreTypes.begin()].insert(((uint32_t)cpu.packageId << 16) | cpu.coreId);
+    }
+    for (size_t i = 0; i < coreTypes.size(); ++i)
+    {
+        x86CoreTypeInfo& coreType = coreTypes[i];
+        coreType.numCores = (uint32_t)cores[i].size();
+        coreType.numLogicalProcessors = (uint32_t)coreType.processors.size();
+        std::thread worker([&coreType, &topology, period]()
+        {
+            if (setThreadAffinity(coreType.processors.front()))
+                readCoreTypeInfo(coreType, topology.hybrid, period);
+        });
+        worker.join();
+    }
+    std::sort(coreTypes.begin(), coreTypes.end(),
+        [](const x86CoreTypeInfo& a, const x86CoreTypeInfo& b)
+        {
+            return (uint8_t)a.type > (uint8_t)b.type;
+        });
+    return coreTypes;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "cpuInfox86.h"
+#include "cpuTopologyx86.h"
+
+/* Class of cores of hybrid processor. Systems without hybrid topology
+   have single class of Unknown type which includes all processors. */
+
+struct x86CoreTypeInfo
+{
+    x86CoreType type;
+    uint32_t nativeModelId;         // Function 0000001Ah EAX bits 23:0
+    uint32_t numCores;
+    uint32_t numLogicalProcessors;
+    std::vector<uint32_t> processors;       // OS logical processor indices
+    std::vector<x86CacheLevelInfo> caches;  // Data and unified levels, from L1
+    uint64_t frequency;             // Effective clock in Hz, zero if not measured
+};
+
+/* Caches and native model are read on the first processor of every class,
+   clock is measured there for period nanoseconds if period is nonzero.
+   Classes are measured one after another, so that turbo budget isn't
+   shared between them. Performance cores come first. */
+
+std::vector<x86CoreTypeInfo> getCoreTypes(const x86ProcessorTopology& topology,
+    uint64_t period = 20000000ull);
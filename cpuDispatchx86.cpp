@@ -0,0 +1,129 @@
+#include <cstdlib>
+#include <cstring>
+#include "cpuDispatchx86.h"
+#include "cpuid.h"
+
+static const char *tierNames[] = {
+    "generic", "sse2", "sse4.2", "avx", "avx2", "avx512"
+};
+
+static std::atomic<int> tierLimit(-1);
+
+static x86FeatureMask readProcessorFeatureMask() noexcept
+{
+    const x86ProcessorInfo& info = queryProcessorInfo(x86SectionFeatures);
+    x86FeatureMask mask;
+    mask.features = info.features;
+    mask.extendedFeatures = info.extendedFeatures;
+    // Instruction sets without OS support would fault
+    const uint64_t stateComponents = getEnabledStateComponents();
+    maskUnusableFeatures(mask.features, stateComponents);
+    maskUnusableFeatures(mask.extendedFeatures, stateComponents);
+    return mask;
+}
+
+const x86FeatureMask& getProcessorFeatureMask() noexcept
+{   // Replayed processor is decoded per thread like queryProcessorInfo()
+    if (getCpuIdSource())
+    {
+        static thread_local x86FeatureMask replayedMask;
+        replayedMask = readProcessorFeatureMask();
+        return replayedMask;
+    }
+    static const x86FeatureMask mask = readProcessorFeatureMask();
+    return mask;
+}
+
+x86FeatureMask getDispatchTierRequirements(x86DispatchTier tier) noexcept
+{
+    x86FeatureMask mask = {};
+    switch (tier)
+    {
+    case x86DispatchTier::AVX512:
+        mask.extendedFeatures.avx512Foundation = 1;
+        mask.extendedFeatures.avx512DoubleAndQuadWord = 1;
+        mask.extendedFeatures.avx512ByteAndWord = 1;
+        mask.extendedFeatures.avx512VectorLength = 1;
+        // fall through
+    case x86DispatchTier::AVX2:
+        mask.extendedFeatures.advancedVectorExtensions2 = 1;
+        mask.extendedFeatures.bitManipulationInstructionSet1 = 1;
+        mask.extendedFeatures.bitManipulationInstructionSet2 = 1;
+        mask.features.fusedMultiplyAdd = 1;
+        // fall through
+    case x86DispatchTier::AVX:
+        mask.features.advancedVectorExtensions = 1;
+        mask.features.operatingSystemXSaveRestore = 1;
+        // fall through
+    case x86DispatchTier::SSE4_2:
+        mask.features.streamingSimdExtensions3 = 1;
+        mask.features.supplementalStreamingSimdExtensions3 = 1;
+        mask.features.streamingSimdExtensions4_1 = 1;
+        mask.features.streamingSimdExtensions4_2 = 1;
+        mask.features.popCount = 1;
+        // fall through
+    case x86DispatchTier::SSE2:
+        mask.features.streamingSimdExtensions = 1;
+        mask.features.streamingSimdExtensions2 = 1;
+        // fall through
+    default:
+        break;
+    }
+    return mask;
+}
+
+bool isFeatureMaskSupported(const x86FeatureMask& requirements) noexcept
+{
+    const x86FeatureMask& supported = getProcessorFeatureMask();
+    return ((supported.features.edx & requirements.features.edx) == requirements.features.edx) &&
+        ((supported.features.ecx & requirements.features.ecx) == requirements.features.ecx) &&
+        ((supported.extendedFeatures.ebx & requirements.extendedFeatures.ebx) == requirements.extendedFeatures.ebx) &&
+        ((supported.extendedFeatures.ecx & requirements.extendedFeatures.ecx) == requirements.extendedFeatures.ecx) &&
+        ((supported.extendedFeatures.edx & requirements.extendedFeatures.edx) == requirements.extendedFeatures.edx);
+}
+
+x86DispatchTier getProcessorDispatchTier() noexcept
+{
+    x86DispatchTier tier = x86DispatchTier::Generic;
+    for (int i = (int)x86DispatchTier::SSE2; i <= (int)x86DispatchTier::AVX512; ++i)
+    {
+        if (!isFeatureMaskSupported(getDispatchTierRequirements((x86DispatchTier)i)))
+            break;
+        tier = (x86DispatchTier)i;
+    }
+    return tier;
+}
+
+const char *stringifyDispatchTier(x86DispatchTier tier) noexcept
+{
+    if (tier > x86DispatchTier::AVX512)
+        return "unknown";
+    return tierNames[(int)tier];
+}
+
+void setDispatchTierLimit(x86DispatchTier tier) noexcept
+{
+    tierLimit.store((int)tier, std::memory_order_relaxed);
+}
+
+x86DispatchTier getDispatchTierLimit() noexcept
+{
+    int limit = tierLimit.load(std::memory_order_relaxed);
+    if (limit < 0)
+    {   // Lookup environment variable only once
+        limit = (int)x86DispatchTier::AVX512;
+        const char *value = getenv("CPUINFO_DISPATCH_TIER");
+        if (value)
+        {
+            for (int i = 0; i <= (int)x86DispatchTier::AVX512; ++i)
+            {
+                if (0 == strcmp(value, tierNames[i]))
+                    limit = i;
+            }
+        }
+        int expected = -1;
+        tierLimit.compare_exchange_strong(expected, limit, std::memory_order_relaxed);
+        limit = tierLimit.load(std::memory_order_relaxed);
+    }
+    return (x86DispatchTier)limit;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "cpuInfox86.h"
+#include "microarchitecture.h"
+
+/* Allows GCC and Clang to compile ISA specific implementation without
+   enabling the ISA for the whole translation unit. MSVC doesn't need it. */
+
+#ifdef _MSC_VER
+#define X86_TARGET(isa)
+#else
+#define X86_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/* Feature bits in the layout decoded by getProcessorInfo(). Processor
+   mask is the usable view: instruction sets whose registers aren't
+   enabled by OS are cleared. */
+
+struct x86FeatureMask
+{
+    x86ProcessorFeatures features;
+    x86ProcessorFeaturesEx extendedFeatures;
+};
+
+/* Dispatch tiers ordered from baseline to the most advanced ISA.
+   Each tier implies features of the previous ones. */
+
+enum class x86DispatchTier : uint8_t
+{
+    Generic, SSE2, SSE4_2, AVX, AVX2, AVX512
+};
+
+/* */
+
+const x86FeatureMask& getProcessorFeatureMask() noexcept;
+x86FeatureMask getDispatchTierRequirements(x86DispatchTier tier) noexcept;
+bool isFeatureMaskSupported(const x86FeatureMask& requirements) noexcept;
+x86DispatchTier getProcessorDispatchTier() noexcept;
+const char *stringifyDispatchTier(x86DispatchTier tier) noexcept;
+
+/* Highest tier allowed for resolution, used for A/B comparisons.
+   Initialized from CPUINFO_DISPATCH_TIER environment variable
+   (generic, sse2, sse4.2, avx, avx2, avx512). Only affects
+   dispatchers that are resolved after the limit has been changed. */
+
+void setDispatchTierLimit(x86DispatchTier tier) noexcept;
+x86DispatchTier getDispatchTierLimit() noexcept;
+
+/* Implementation of dispatched function. Features of the tier are
+   required implicitly, extra requirements are added on top of them.
+   Candidate is vetoed on parts with any of avoided traits, e.g. PDEP
+   based one with x86TraitMicrocodedPdepPext. */
+
+template<class Fn>
+struct x86DispatchCandidate
+{
+    x86DispatchCandidate(x86DispatchTier tier, Fn fn, const char *name) noexcept:
+        tier(tier), requirements(getDispatchTierRequirements(tier)), avoidedTraits(0), fn(fn), name(name) {}
+    x86DispatchCandidate(x86DispatchTier tier, const x86FeatureMask& extra, Fn fn, const char *name,
+        uint32_t avoidedTraits = 0) noexcept:
+        tier(tier), requirements(getDispatchTierRequirements(tier)), avoidedTraits(avoidedTraits),
+        fn(fn), name(name)
+    {
+        requirements.features.edx |= extra.features.edx;
+        requirements.features.ecx |= extra.features.ecx;
+        requirements.extendedFeatures.ebx |= extra.extendedFeatures.ebx;
+        requirements.extendedFeatures.ecx |= extra.extendedFeatures.ecx;
+        requirements.extendedFeatures.edx |= extra.extendedFeatures.edx;
+    }
+
+    x86DispatchTier tier;
+    x86FeatureMask requirements;
+    uint32_t avoidedTraits;     // x86MicroarchitectureTrait
+    Fn fn;
+    const char *name;
+};
+
+/* Resolves the highest tier supported implementation on the first call
+   and caches it, so that subsequent calls cost a single indirect call.
+   The first candidate is used if none of them is supported, hence
+   it should be a generic implementation. Constructor throws
+   std::invalid_argument if the list of candidates is empty. */
+
+template<class Fn>
+class x86Dispatcher
+{
+public:
+    x86Dispatcher(std::initializer_list<x86DispatchCandidate<Fn>> candidates):
+        candidates(candidates), resolved(nullptr), selected(0),
+        maxTier(x86DispatchTier::AVX512)
+    {
+        if (this->candidates.empty())
+            throw std::invalid_argument("dispatcher requires at least one candidate");
+    }
+
+    Fn get() noexcept
+    {
+        const Fn fn = resolved.load(std::memory_order_acquire);
+        return fn ? fn : resolve();
+    }
+
+    template<class... Args>
+    auto operator()(Args&&... args) -> decltype(std::declval<Fn>()(std::forward<Args>(args)...))
+    {
+        return get()(std::forward<Args>(args)...);
+    }
+
+    const char *getName() noexcept
+    {
+        get();
+        return candidates[selected.load(std::memory_order_acquire)].name;
+    }
+
+    void forceTier(x86DispatchTier tier) noexcept
+    {   // Resolve again with lower limit
+        maxTier.store(tier, std::memory_order_relaxed);
+        resolved.store(nullptr, std::memory_order_release);
+    }
+
+private:
+    Fn resolve() noexcept
+    {   // Resolution is idempotent, so concurrent callers may race safely
+        const x86DispatchTier limit = std::min(getDispatchTierLimit(),
+            maxTier.load(std::memory_order_relaxed));
+        size_t best = 0;
+        bool found = false;
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            const x86DispatchCandidate<Fn>& candidate = candidates[i];
+            if (candidate.tier > limit || !isFeatureMaskSupported(candidate.requirements) ||
+                (candidate.avoidedTraits & getProcessorTraits()))
+                continue;
+            if (!found || candidate.tier > candidates[best].tier)
+            {
+                best = i;
+                found = true;
+            }
+        }
+        selected.store(best, std::memory_order_release);
+        resolved.store(candidates[best].fn, std::memory_order_release);
+        return candidates[best].fn;
+    }
+
+    const std::vector<x86DispatchCandidate<Fn>> candidates;
+    std::atomic<Fn> resolved;
+    std::atomic<size_t> selected;
+    std::atomic<x86DispatchTier> maxTier;
+};
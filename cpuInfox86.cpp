@@ -1,7 +1,13 @@
 #ifdef _WIN32
 #include <windows.h>
 #pragma comment(lib, "advapi32.lib")
+#elif defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
 #endif
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include "cpuInfox86.h"
 #include "cpuid.h"
 
@@ -20,11 +26,27 @@ static const CpuVendor vendorIds[] = {
     {CPUID_VENDOR_UNKNOWN, x86VendorId::Unknown}
 };
 
-x86ProcessorInfo getProcessorInfo()
+struct CpuIdLimits
 {
-    x86ProcessorInfo cpuInfo = {};
+    int numIds;
+    int numIdsEx;
+};
+
+static CpuIdLimits readLimits() noexcept
+{
+    CpuIdLimits limits;
     CpuId cpuId;
-    __cpuid(&cpuId.eax, 0);
+    readCpuId(&cpuId.eax, 0);
+    limits.numIds = cpuId.eax;
+    readCpuId(&cpuId.eax, CPUID_EXTENDED_ID); // Get highest valid extended ID
+    limits.numIdsEx = cpuId.eax;
+    return limits;
+}
+
+static void readVendor(x86ProcessorInfo& cpuInfo) noexcept
+{
+    CpuId cpuId;
+    readCpuId(&cpuId.eax, 0);
     // A twelve-character ASCII string stored in ebx, edx, ecx
     const int vendor[3] = {cpuId.ebx, cpuId.edx, cpuId.ecx};
     memcpy(cpuInfo.vendor, vendor, sizeof(vendor));
@@ -36,57 +58,180 @@ x86ProcessorInfo getProcessorInfo()
             break;
         }
     }
-    const bool isIntel = (x86VendorId::Intel == cpuInfo.vendorId);
-    const bool isAMD = (x86VendorId::AMD == cpuInfo.vendorId);
-    const int numIds = cpuId.eax;
-    std::vector<CpuId> cpuIds(numIds + 1);
-    for (int i = 0; i <= numIds; ++i)
-        __cpuidex(&cpuIds[i].eax, i, 0);
-    if (numIds >= 1)
+}
+
+static void readFeatures(x86ProcessorInfo& cpuInfo, const CpuIdLimits& limits) noexcept
+{
+    CpuId cpuId;
+    if (limits.numIds >= 1)
     {   // Signature of a CPU
-        cpuInfo.signature.eax = cpuIds[1].eax;
+        readCpuId(&cpuId.eax, 0x1);
+        cpuInfo.signature.eax = cpuId.eax;
         // Additional info
-        cpuInfo.misc.ebx = cpuIds[1].ebx;
+        cpuInfo.misc.ebx = cpuId.ebx;
         // Processor feature flags
-        cpuInfo.features.edx = cpuIds[1].edx;
-        cpuInfo.features.ecx = cpuIds[1].ecx;
+        cpuInfo.features.edx = cpuId.edx;
+        cpuInfo.features.ecx = cpuId.ecx;
+    }
+    if (limits.numIds >= 0x6)
+    {   // Thermal power management feature flags
+        readCpuId(&cpuId.eax, 0x6);
+        cpuInfo.tpmFeatures.eax = cpuId.eax;
+        cpuInfo.tpmFeatures.ebx = cpuId.ebx;
+        cpuInfo.tpmFeatures.ecx = cpuId.ecx;
+    }
+    if ((limits.numIds >= 0xD) && cpuInfo.features.xsaveRestore)
+    {   // Extended state sizes, components are enumerated by their own subleaves
+        readCpuIdEx(&cpuInfo.extendedState.reg[0], 0xD, 0);
+        readCpuIdEx(&cpuInfo.extendedState.reg[4], 0xD, 1);
+        const uint64_t components = cpuInfo.extendedState.supportedComponents |
+            cpuInfo.extendedState.supervisorComponents;
+        for (uint32_t component = 2; component < X86_MAX_STATE_COMPONENTS; ++component)
+        {
+            if (components & (1ull << component))
+                readCpuIdEx(cpuInfo.stateComponents[component].reg, 0xD, component);
+        }
+    }
+    if (limits.numIds >= 0x7)
+    {   // Extended feature flags
+        readCpuIdEx(&cpuId.eax, 0x7, 0);
+        cpuInfo.extendedFeatures.ebx = cpuId.ebx;
+        cpuInfo.extendedFeatures.ecx = cpuId.ecx;
+        cpuInfo.extendedFeatures.edx = cpuId.edx;
+    }
+    if (limits.numIdsEx >= CPUID_EXTENDED_ID + 0x1)
+    {   // AMD processor extended feature flags, Intel reports a subset of them
+        readCpuId(&cpuId.eax, CPUID_EXTENDED_ID + 0x1);
+        cpuInfo.featuresAMD.edx = cpuId.edx;
+        cpuInfo.featuresAMD.ecx = cpuId.ecx;
+    }
+    if (limits.numIdsEx >= CPUID_EXTENDED_ID + 0x7)
+    {   // Advanced power management feature flags
+        readCpuId(&cpuId.eax, CPUID_EXTENDED_ID + 0x7);
+        cpuInfo.apmFeatures.edx = cpuId.edx;
+    }
+}
+
+static void readBrand(x86ProcessorInfo& cpuInfo, const CpuIdLimits& limits) noexcept
+{
+    if (limits.numIdsEx >= CPUID_EXTENDED_ID + 0x4)
+    {   // Interpret processor brand string if supported
+        CpuId cpuIds[3];
+        for (int i = 0; i < 3; ++i)
+            readCpuId(&cpuIds[i].eax, CPUID_EXTENDED_ID + 0x2 + i);
+        memcpy(cpuInfo.brand, cpuIds, sizeof(cpuIds)); // 0x2, 0x3, 0x4
+    }
+}
+
+#define TOPOEXT_BIT         (1 << 22)
+
+static void readDeterministicCaches(x86ProcessorInfo& cpuInfo, int id)
+{
+    int ecx = 0;
+    while (true)
+    {
+        x86DeterministicCacheInfo cacheInfo;
+        readCpuIdEx(cacheInfo.reg, id, ecx++);
+        if (!cacheInfo.cacheType)
+           break;
+        cacheInfo.maxAddressableIdsForLogicalProcessors += 1;
+        cacheInfo.maxAddressableIdsForProcessorCores += 1;
+        cacheInfo.systemCoherencyLineSize += 1;
+        cacheInfo.physicalLinePartitions += 1;
+        cacheInfo.associativity += 1;
+        cacheInfo.numSets += 1;
+        cpuInfo.cacheInfos.push_back(cacheInfo);
+    }
+}
+
+static void readCaches(x86ProcessorInfo& cpuInfo, const CpuIdLimits& limits)
+{
+    const bool isIntel = (x86VendorId::Intel == cpuInfo.vendorId);
+    const bool isAMD = (x86VendorId::AMD == cpuInfo.vendorId) ||
+        (x86VendorId::Hygon == cpuInfo.vendorId);
+    bool hasTopologyExtensions = false;
+    CpuId cpuId;
+    if ((limits.numIdsEx >= CPUID_EXTENDED_ID + 0x1) && isAMD)
+    {
+        readCpuId(&cpuId.eax, CPUID_EXTENDED_ID + 0x1);
+        hasTopologyExtensions = (cpuId.ecx & TOPOEXT_BIT) != 0;
     }
-    if (numIds >= 0x4 && isIntel)
+    if (limits.numIds >= 0x4 && isIntel)
     {   // Intel deterministic cache parameters
-        int ecx = 0;
-        while (true)
+        readDeterministicCaches(cpuInfo, 0x4);
+    }
+    if (limits.numIds >= 0x2 && isIntel)
+    {   // Cache and TLB descriptors, register with bit 31 set is reserved
+        readCpuId(&cpuId.eax, 0x2);
+        cpuInfo.l1Cache.eax = (cpuId.eax < 0) ? 0 : cpuId.eax & ~0xFF;
+        cpuInfo.l1Cache.ebx = (cpuId.ebx < 0) ? 0 : cpuId.ebx;
+        cpuInfo.l1Cache.ecx = (cpuId.ecx < 0) ? 0 : cpuId.ecx;
+        cpuInfo.l1Cache.edx = (cpuId.edx < 0) ? 0 : cpuId.edx;
+    }
+    if (limits.numIds >= 0x18 && isIntel)
+    {   // Deterministic address translation parameters, invalid subleaves may be interleaved
+        x86DeterministicTlbInfo tlbInfo;
+        readCpuIdEx(tlbInfo.reg, 0x18, 0);
+        const uint32_t maxSubleaf = tlbInfo.maxSubleaf;
+        for (uint32_t subleaf = 0; subleaf <= maxSubleaf; ++subleaf)
         {
-            x86DeterministicCacheInfo cacheInfo;
-            __cpuidex(cacheInfo.reg, 0x4, ecx++);
-            if (!cacheInfo.cacheType)
-               break;
-            cacheInfo.maxAddressableIdsForLogicalProcessors += 1;
-            cacheInfo.maxAddressableIdsForProcessorCores += 1;
-            cacheInfo.systemCoherencyLineSize += 1;
-            cacheInfo.physicalLinePartitions += 1;
-            cacheInfo.associativity += 1;
-            cacheInfo.numSets += 1;
-            cpuInfo.cacheInfos.push_back(cacheInfo);
+            if (subleaf)
+                readCpuIdEx(tlbInfo.reg, 0x18, subleaf);
+            if (!tlbInfo.tlbType)
+                continue;
+            tlbInfo.maxAddressableIdsForLogicalProcessors += 1;
+            cpuInfo.tlbInfos.push_back(tlbInfo);
         }
     }
-    if (numIds >= 0x6)
-    {   // Thermal power management feature flags
-        cpuInfo.tpmFeatures.eax = cpuIds[0x6].eax;
-        cpuInfo.tpmFeatures.ebx = cpuIds[0x6].ebx;
-        cpuInfo.tpmFeatures.ecx = cpuIds[0x6].ecx;
+    if ((limits.numIdsEx >= CPUID_EXTENDED_ID + 0x1D) && hasTopologyExtensions)
+    {   // AMD cache topology information
+        readDeterministicCaches(cpuInfo, CPUID_EXTENDED_ID + 0x1D);
     }
-    if (numIds >= 0x7)
-    {   // Extended feature flags
-        cpuInfo.extendedFeatures.ebx = cpuIds[0x7].ebx;
-        cpuInfo.extendedFeatures.ecx = cpuIds[0x7].ecx;
-        cpuInfo.extendedFeatures.edx = cpuIds[0x7].edx;
+    if ((limits.numIdsEx >= CPUID_EXTENDED_ID + 0x5) && isAMD)
+    {   // L1 Cache and TLB Identifiers
+        readCpuId(&cpuId.eax, CPUID_EXTENDED_ID + 0x5);
+        cpuInfo.l1CacheAMD.eax = cpuId.eax;
+        cpuInfo.l1CacheAMD.ebx = cpuId.ebx;
+        cpuInfo.l1CacheAMD.ecx = cpuId.ecx;
+        cpuInfo.l1CacheAMD.edx = cpuId.edx;
+    }
+    if (limits.numIdsEx >= CPUID_EXTENDED_ID + 0x6)
+    {   // Extended L2 Cache Features
+        readCpuId(&cpuId.eax, CPUID_EXTENDED_ID + 0x6);
+        cpuInfo.l2Cache.ecx = cpuId.ecx;
+        if (isAMD)
+        {
+            cpuInfo.l3Cache.edx = cpuId.edx;
+            cpuInfo.tlbAMD.eax = cpuId.eax;
+            cpuInfo.tlbAMD.ebx = cpuId.ebx;
+        }
     }
-    if (numIds >= 0x16 && isIntel)
+    if ((limits.numIdsEx >= CPUID_EXTENDED_ID + 0x19) && isAMD)
+    {   // AMD 1 GB page TLB identifiers
+        readCpuId(&cpuId.eax, CPUID_EXTENDED_ID + 0x19);
+        cpuInfo.tlbAMD.eax1G = cpuId.eax;
+        cpuInfo.tlbAMD.ebx1G = cpuId.ebx;
+    }
+    if ((limits.numIdsEx >= CPUID_EXTENDED_ID + 0x1E) && hasTopologyExtensions)
+    {   // AMD extended APIC ID, core and node identifiers
+        readCpuId(&cpuId.eax, CPUID_EXTENDED_ID + 0x1E);
+        cpuInfo.extendedApicIdAMD.eax = cpuId.eax;
+        cpuInfo.extendedApicIdAMD.ebx = cpuId.ebx;
+        cpuInfo.extendedApicIdAMD.ecx = cpuId.ecx;
+    }
+}
+
+static void readFrequency(x86ProcessorInfo& cpuInfo, const CpuIdLimits& limits) noexcept
+{
+    const bool isIntel = (x86VendorId::Intel == cpuInfo.vendorId);
+    if (limits.numIds >= 0x16 && isIntel)
     {   // Processor frequency information
-        cpuInfo.frequency.eax = cpuIds[0x16].eax;
-        cpuInfo.frequency.ebx = cpuIds[0x16].ebx;
-        cpuInfo.frequency.ecx = cpuIds[0x16].ecx;
-    } else
+        CpuId cpuId;
+        readCpuId(&cpuId.eax, 0x16);
+        cpuInfo.frequency.eax = cpuId.eax;
+        cpuInfo.frequency.ebx = cpuId.ebx;
+        cpuInfo.frequency.ecx = cpuId.ecx;
+    } else if (!getCpuIdSource())
     {   // Use fallback for frequency information
     #ifdef _WIN32
         HKEY key = NULL;
@@ -102,68 +247,70 @@ x86ProcessorInfo getProcessorInfo()
     #else
     #endif // _WIN32
     }
-    __cpuid(&cpuId.eax, CPUID_EXTENDED_ID); // Get highest valid extended ID
-    const int numIdsEx = cpuId.eax;
-    std::vector<CpuId> cpuIdsEx;
-    for (int id = CPUID_EXTENDED_ID; id <= numIdsEx; ++id)
-    {
-        __cpuid(&cpuId.eax, id);
-        cpuIdsEx.push_back(cpuId);
-    }
-    if ((numIdsEx >= CPUID_EXTENDED_ID + 0x1) && isAMD)
-    {   // AMD processor extended feature flags
-        cpuInfo.featuresAMD.edx = cpuIdsEx[0x1].edx;
-        cpuInfo.featuresAMD.ecx = cpuIdsEx[0x1].ecx;
-    }
-    if (numIdsEx >= CPUID_EXTENDED_ID + 0x4)
-    {   // Interpret processor brand string if supported
-        memcpy(cpuInfo.brand, &cpuIdsEx[0x2], sizeof(CpuId) * 3); // 0x2, 0x3, 0x4
-    }
-    if ((numIdsEx >= CPUID_EXTENDED_ID + 0x5) && isAMD)
-    {   // L1 Cache and TLB Identifiers
-        cpuInfo.l1CacheAMD.eax = cpuIdsEx[0x5].eax;
-        cpuInfo.l1CacheAMD.ebx = cpuIdsEx[0x5].ebx;
-        cpuInfo.l1CacheAMD.ecx = cpuIdsEx[0x5].ecx;
-        cpuInfo.l1CacheAMD.edx = cpuIdsEx[0x5].edx;
-    }
-    if (numIdsEx >= CPUID_EXTENDED_ID + 0x6)
-    {   // Extended L2 Cache Features
-        cpuInfo.l2Cache.ecx = cpuIdsEx[0x6].ecx;
-    }
-    if (numIdsEx >= CPUID_EXTENDED_ID + 0x7)
-    {   // Advanced power management feature flags
-        cpuInfo.apmFeatures.edx = cpuIdsEx[0x7].edx;
-    }
-    return cpuInfo;
 }
 
-enum TopologyLevelType : uint8_t
+static void readSections(x86ProcessorInfo& cpuInfo, uint32_t sections)
 {
-    Invalid, SMT, Core, Module, Tile, Die
-};
+    const CpuIdLimits limits = readLimits();
+    if (sections & x86SectionVendor)
+        readVendor(cpuInfo);
+    if (sections & x86SectionFeatures)
+        readFeatures(cpuInfo, limits);
+    if (sections & x86SectionBrand)
+        readBrand(cpuInfo, limits);
+    if (sections & x86SectionCaches)
+        readCaches(cpuInfo, limits);
+    if (sections & x86SectionFrequency)
+        readFrequency(cpuInfo, limits);
+}
 
-struct CpuExtTopology
+x86ProcessorInfo getProcessorInfo()
 {
-    uint32_t bitsToShiftRightX2ApicId: 5;
-    uint32_t reserved: 27;
-    uint32_t numLogicalProcessors: 16;
-    uint32_t reserved2: 16;
-    uint32_t levelNumber: 8;
-    uint32_t levelType: 8;
-    uint32_t reserved3: 16;
-    uint32_t x2ApicId: 32;
-};
+    x86ProcessorInfo cpuInfo = {};
+    readSections(cpuInfo, x86SectionAll);
+    return cpuInfo;
+}
+
+static x86ProcessorInfo cachedInfo = {};
+static std::atomic<uint32_t> cachedSections(0);
+static std::mutex cacheMutex;
+
+const x86ProcessorInfo& queryProcessorInfo(uint32_t sections /* x86SectionAll */)
+{
+    const CpuIdReplayState& replay = getCpuIdReplayState();
+    if (replay.source)
+    {   // Replayed information is decoded completely and never shared between threads
+        static thread_local x86ProcessorInfo replayedInfo = {};
+        static thread_local uint64_t replayedGeneration = 0;
+        if (replayedGeneration != replay.generation)
+        {
+            replayedInfo = getProcessorInfo();
+            replayedGeneration = replay.generation;
+        }
+        return replayedInfo;
+    }
+    sections |= x86SectionVendor; // Other sections depend on vendor
+    if ((cachedSections.load(std::memory_order_acquire) & sections) != sections)
+    {   // Populate missing sections only
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        const uint32_t missing = sections & ~cachedSections.load(std::memory_order_relaxed);
+        if (missing)
+        {
+            readSections(cachedInfo, missing);
+            cachedSections.fetch_or(missing, std::memory_order_release);
+        }
+    }
+    return cachedInfo;
+}
 
 #define CMP_LEGACY_BIT      (1 << 1)
 #define HTT_BIT             (1 << 28)
-#define TSC_BIT             (1 << 4)
-#define INVARIANT_TSC_BIT   (1 << 8)
 
-uint32_t getProcessorPhysicalThreadCount() noexcept
+static uint32_t readProcessorPhysicalThreadCount() noexcept
 {
     uint32_t physicalThreadCount = 0;
     CpuId cpuId;
-    __cpuid(&cpuId.eax, 0);
+    readCpuId(&cpuId.eax, 0);
     if (cpuidIsVendor(CPUID_VENDOR_INTEL, cpuId))
     {   // Get highest topology leaf
         const int numIds = cpuId.eax;
@@ -174,7 +321,7 @@ uint32_t getProcessorPhysicalThreadCount() noexcept
             int level = 0;
             while (topology.levelType != TopologyLevelType::Core)
             {   // SMT related to physical cores, Core related to logical ones
-                __cpuidex((int *)&topology, id, level++);
+                readCpuIdEx((int *)&topology, id, level++);
                 if (!topology.numLogicalProcessors)
                     break;
             }
@@ -183,27 +330,27 @@ uint32_t getProcessorPhysicalThreadCount() noexcept
         }
     } else if (cpuidIsVendor(CPUID_VENDOR_AMD, cpuId))
     {   // Get highest valid extended ID
-        __cpuid(&cpuId.eax, CPUID_EXTENDED_ID);
+        readCpuId(&cpuId.eax, CPUID_EXTENDED_ID);
         const int numIdsEx = cpuId.eax;
         if (numIdsEx >= CPUID_EXTENDED_ID + 0x8)
         {   // Use extended size identifiers
-            __cpuid(&cpuId.eax, CPUID_EXTENDED_ID + 0x8);
+            readCpuId(&cpuId.eax, CPUID_EXTENDED_ID + 0x8);
             physicalThreadCount = (cpuId.ecx & 0x000000FF) + 1;
         } else if (numIdsEx >= CPUID_EXTENDED_ID + 0x1)
         {   // Check that legacy method is supported
-            __cpuid(&cpuId.eax, CPUID_EXTENDED_ID + 0x1);
+            readCpuId(&cpuId.eax, CPUID_EXTENDED_ID + 0x1);
             const bool coreMultiProcessingLegacyMode = cpuId.ecx & CMP_LEGACY_BIT;
             if (coreMultiProcessingLegacyMode)
             {   // When HTT = 1 and CmpLegacy = 1, LogicalProcessorCount represents
                 // the number of logical processors per package
-                __cpuid(&cpuId.eax, 0x1);
+                readCpuId(&cpuId.eax, 0x1);
                 const bool hyperThreading = cpuId.edx & HTT_BIT;
                 if (hyperThreading)
                     physicalThreadCount = (cpuId.ebx & 0x00FF0000) >> 16; // bits 23:16
             }
         }
     }
-    if (!physicalThreadCount)
+    if (!physicalThreadCount && !getCpuIdSource())
     {   // Fallback method
     #ifdef _WIN32
         HKEY key = NULL;
@@ -226,24 +373,33 @@ uint32_t getProcessorPhysicalThreadCount() noexcept
     return physicalThreadCount;
 }
 
+uint32_t getProcessorPhysicalThreadCount() noexcept
+{   // Thread count doesn't change, so it's safe to race on first call
+    if (getCpuIdSource())
+        return readProcessorPhysicalThreadCount();
+    static std::atomic<uint32_t> physicalThreadCount(0);
+    uint32_t count = physicalThreadCount.load(std::memory_order_relaxed);
+    if (!count)
+    {
+        count = readProcessorPhysicalThreadCount();
+        physicalThreadCount.store(count, std::memory_order_relaxed);
+    }
+    return count;
+}
+
 uint64_t waitNanoseconds(uint64_t ns) noexcept;
 
 uint64_t getProcessorFrequency(uint64_t period /* 1000000000 */) noexcept
 {
-    CpuId cpuId[2] = {};
-    __cpuid(&cpuId[0].eax, 0);
-    if (cpuId[0].eax >= 0x1)
-        __cpuid(&cpuId[0].eax, 0x1); // Processor feature flags
-    __cpuid(&cpuId[1].eax, CPUID_EXTENDED_ID); // Get highest valid extended ID
-    if (cpuId[1].eax >= CPUID_EXTENDED_ID + 0x7)
-        __cpuid(&cpuId[1].eax, CPUID_EXTENDED_ID + 0x7); // Advanced power management feature flags
-    if ((cpuId[0].edx & TSC_BIT) &&
-        (cpuId[1].edx & INVARIANT_TSC_BIT))
+    const x86ProcessorInfo& cpuInfo = queryProcessorInfo(x86SectionFeatures);
+    if (cpuInfo.features.timestampCounter &&
+        cpuInfo.apmFeatures.invariantTimestampCounter)
     {
+        CpuId cpuId;
         uint64_t begin = __rdtsc();
         {   // Wait for specified period and store the actual wait period
             period = waitNanoseconds(period);
-            __cpuid(&cpuId[0].eax, 0); // Insert barrier
+            __cpuid(&cpuId.eax, 0); // Insert barrier
         }
         uint64_t end = __rdtsc();
         // Adjust multiplier according to returned wait period
@@ -254,12 +410,473 @@ uint64_t getProcessorFrequency(uint64_t period /* 1000000000 */) noexcept
     return 0ull;
 }
 
+#define HYPERVISOR_ID       0x40000000
+#define HYPERVISOR_BIT      (1 << 31)
+
+static uint64_t getCrystalClockFrequency(const x86ProcessorInfo& cpuInfo) noexcept
+{   // Processors which don't enumerate nominal frequency of the core crystal clock
+    const x86ProcessorSignature& signature = cpuInfo.signature;
+    if (signature.familyId != 0x6)
+        return 0ull;
+    switch ((signature.extendedModelId << 4) | signature.model)
+    {
+    case 0x4E: // Skylake mobile
+    case 0x5E: // Skylake desktop
+    case 0x8E: // Kaby Lake mobile
+    case 0x9E: // Kaby Lake desktop
+        return 24000000ull;
+    case 0x5F: // Goldmont D (Denverton)
+        return 25000000ull;
+    case 0x5C: // Goldmont (Apollo Lake)
+        return 19200000ull;
+    default:
+        return 0ull;
+    }
+}
+
+static x86TscFrequency readTscFrequency(uint64_t period) noexcept
+{
+    const x86ProcessorInfo& cpuInfo = queryProcessorInfo(x86SectionFeatures);
+    x86TscFrequency tsc = {0ull, x86TscFrequencySource::Unknown};
+    CpuId cpuId;
+    readCpuId(&cpuId.eax, 0);
+    const int numIds = cpuId.eax;
+    if (numIds >= 0x15)
+    {   // Time stamp counter and nominal core crystal clock information
+        readCpuId(&cpuId.eax, 0x15);
+        const uint32_t denominator = cpuId.eax;
+        const uint32_t numerator = cpuId.ebx;
+        uint64_t crystalFrequency = (uint32_t)cpuId.ecx;
+        if (!crystalFrequency)
+            crystalFrequency = getCrystalClockFrequency(cpuInfo);
+        if (denominator && numerator && crystalFrequency)
+        {
+            tsc.frequency = crystalFrequency * numerator/denominator;
+            tsc.source = x86TscFrequencySource::CrystalClock;
+            return tsc;
+        }
+    }
+    if (numIds >= 0x16)
+    {   // TSC runs at base frequency when crystal clock is not enumerated
+        readCpuId(&cpuId.eax, 0x16);
+        const uint32_t baseFrequency = cpuId.eax & 0xFFFF; // In MHz
+        if (baseFrequency)
+        {
+            tsc.frequency = baseFrequency * 1000000ull;
+            tsc.source = x86TscFrequencySource::BaseFrequency;
+            return tsc;
+        }
+    }
+    if (cpuInfo.features.ecx & HYPERVISOR_BIT)
+    {   // Timing information leaf, supported by VMware and KVM
+        readCpuId(&cpuId.eax, HYPERVISOR_ID);
+        if ((uint32_t)cpuId.eax >= HYPERVISOR_ID + 0x10)
+        {
+            readCpuId(&cpuId.eax, HYPERVISOR_ID + 0x10);
+            if (cpuId.eax)
+            {
+                tsc.frequency = (uint32_t)cpuId.eax * 1000ull; // In kHz
+                tsc.source = x86TscFrequencySource::Hypervisor;
+                return tsc;
+            }
+        }
+    }
+    if (getCpuIdSource())
+        return tsc; // Recorded processor can't be measured
+    tsc.frequency = getProcessorFrequency(period);
+    if (tsc.frequency)
+        tsc.source = x86TscFrequencySource::Measured;
+    return tsc;
+}
+
+x86TscFrequency getTscFrequency(uint64_t period /* 100000000 */) noexcept
+{   // Period is used only if measurement is required on the first call
+    if (getCpuIdSource())
+        return readTscFrequency(period);
+    static const x86TscFrequency tscFrequency = readTscFrequency(period);
+    return tscFrequency;
+}
+
+uint32_t getDeterministicCacheSize(const x86DeterministicCacheInfo& cache) noexcept
+{
+    return cache.associativity * cache.physicalLinePartitions *
+        cache.systemCoherencyLineSize * cache.numSets;
+}
+
+static uint32_t decodeCacheAssociativity(uint32_t associativity) noexcept
+{   // Encoding of Function 80000006h
+    switch (associativity)
+    {
+    case 0x1: return 1;
+    case 0x2: return 2;
+    case 0x4: return 4;
+    case 0x6: return 8;
+    case 0x8: return 16;
+    case 0xA: return 32;
+    case 0xB: return 48;
+    case 0xC: return 64;
+    case 0xD: return 96;
+    case 0xE: return 128;
+    default: return 0;
+    }
+}
+
+bool getDataCacheLevel(const x86ProcessorInfo& info, uint32_t level, x86CacheLevelInfo& cache) noexcept
+{
+    for (const auto& it: info.cacheInfos)
+    {
+        if ((it.level == level) &&
+            ((x86CacheType::Data == (x86CacheType)it.cacheType) ||
+             (x86CacheType::Unified == (x86CacheType)it.cacheType)))
+        {
+            cache.level = level;
+            cache.size = getDeterministicCacheSize(it);
+            cache.lineSize = it.systemCoherencyLineSize;
+            cache.associativity = it.fullyAssociative ? 0 : it.associativity;
+            cache.sharingLogicalProcessors = it.maxAddressableIdsForLogicalProcessors;
+            return true;
+        }
+    }
+    // Fallback to legacy leaves
+    if ((1 == level) && info.l1CacheAMD.dataCache.cacheSize)
+    {
+        cache.level = level;
+        cache.size = info.l1CacheAMD.dataCache.cacheSize * 1024;
+        cache.lineSize = info.l1CacheAMD.dataCache.lineSize;
+        cache.associativity = (0xFF == info.l1CacheAMD.dataCache.associativity) ? 0 :
+            info.l1CacheAMD.dataCache.associativity;
+        cache.sharingLogicalProcessors = 0;
+        return true;
+    }
+    if ((2 == level) && info.l2Cache.cacheSize)
+    {
+        cache.level = level;
+        cache.size = info.l2Cache.cacheSize * 1024;
+        cache.lineSize = info.l2Cache.lineSize;
+        cache.associativity = decodeCacheAssociativity(info.l2Cache.associativity);
+        cache.sharingLogicalProcessors = 0;
+        return true;
+    }
+    if ((3 == level) && info.l3Cache.cacheSize)
+    {
+        cache.level = level;
+        cache.size = info.l3Cache.cacheSize * 512 * 1024;
+        cache.lineSize = info.l3Cache.lineSize;
+        cache.associativity = decodeCacheAssociativity(info.l3Cache.associativity);
+        cache.sharingLogicalProcessors = 0;
+        return true;
+    }
+    return false;
+}
+
+/* TLB descriptors of Function 00000002h, descriptors of caches and
+   prefetching are omitted as caches are enumerated by Function 00000004h.
+   Some descriptors describe two TLBs. */
+
+struct TlbDescriptor
+{
+    uint8_t descriptor;
+    uint8_t level;
+    x86TlbType type;
+    uint8_t pageSizes;
+    uint16_t numEntries;
+    uint8_t associativity; // 0 if fully associative or unspecified
+};
+
+#define PAGE_4K         x86PageSize4K
+#define PAGE_2M4M       (x86PageSize2M | x86PageSize4M)
+#define PAGE_4K2M       (x86PageSize4K | x86PageSize2M)
+#define PAGE_4K4M       (x86PageSize4K | x86PageSize4M)
+#define PAGE_ALL        (x86PageSize4K | x86PageSize2M | x86PageSize4M)
+
+static const TlbDescriptor tlbDescriptors[] = {
+    {0x01, 1, x86TlbType::Instruction, PAGE_4K, 32, 4},
+    {0x02, 1, x86TlbType::Instruction, x86PageSize4M, 2, 0},
+    {0x03, 1, x86TlbType::Data, PAGE_4K, 64, 4},
+    {0x04, 1, x86TlbType::Data, x86PageSize4M, 8, 4},
+    {0x05, 1, x86TlbType::Data, x86PageSize4M, 32, 4},
+    {0x0B, 1, x86TlbType::Instruction, x86PageSize4M, 4, 4},
+    {0x4F, 1, x86TlbType::Instruction, PAGE_4K, 32, 0},
+    {0x50, 1, x86TlbType::Instruction, PAGE_ALL, 64, 0},
+    {0x51, 1, x86TlbType::Instruction, PAGE_ALL, 128, 0},
+    {0x52, 1, x86TlbType::Instruction, PAGE_ALL, 256, 0},
+    {0x55, 1, x86TlbType::Instruction, PAGE_2M4M, 7, 0},
+    {0x56, 1, x86TlbType::Data, x86PageSize4M, 16, 4},
+    {0x57, 1, x86TlbType::Data, PAGE_4K, 16, 4},
+    {0x59, 1, x86TlbType::Data, PAGE_4K, 16, 0},
+    {0x5A, 1, x86TlbType::Data, PAGE_2M4M, 32, 4},
+    {0x5B, 1, x86TlbType::Data, PAGE_4K4M, 64, 0},
+    {0x5C, 1, x86TlbType::Data, PAGE_4K4M, 128, 0},
+    {0x5D, 1, x86TlbType::Data, PAGE_4K4M, 256, 0},
+    {0x61, 1, x86TlbType::Instruction, PAGE_4K, 48, 0},
+    {0x63, 1, x86TlbType::Data, PAGE_2M4M, 32, 4},
+    {0x63, 1, x86TlbType::Data, x86PageSize1G, 4, 4},
+    {0x64, 1, x86TlbType::Data, PAGE_4K, 512, 4},
+    {0x6A, 1, x86TlbType::Data, PAGE_4K, 64, 8},
+    {0x6B, 1, x86TlbType::Data, PAGE_4K, 256, 8},
+    {0x6C, 1, x86TlbType::Data, PAGE_2M4M, 128, 8},
+    {0x6D, 1, x86TlbType::Data, x86PageSize1G, 16, 0},
+    {0x76, 1, x86TlbType::Instruction, PAGE_2M4M, 8, 0},
+    {0xA0, 1, x86TlbType::Data, PAGE_4K, 32, 0},
+    {0xB0, 1, x86TlbType::Instruction, PAGE_4K, 128, 4},
+    {0xB1, 1, x86TlbType::Instruction, x86PageSize2M, 8, 4},
+    {0xB2, 1, x86TlbType::Instruction, PAGE_4K, 64, 4},
+    {0xB3, 1, x86TlbType::Data, PAGE_4K, 128, 4},
+    {0xB4, 1, x86TlbType::Data, PAGE_4K, 256, 4},
+    {0xB5, 1, x86TlbType::Instruction, PAGE_4K, 64, 8},
+    {0xB6, 1, x86TlbType::Instruction, PAGE_4K, 128, 8},
+    {0xBA, 1, x86TlbType::Data, PAGE_4K, 64, 4},
+    {0xC0, 1, x86TlbType::Data, PAGE_4K4M, 8, 4},
+    {0xC1, 2, x86TlbType::Unified, PAGE_4K2M, 1024, 8},
+    {0xC2, 1, x86TlbType::Data, PAGE_4K2M, 16, 4},
+    {0xC3, 2, x86TlbType::Unified, PAGE_4K2M, 1536, 6},
+    {0xC3, 2, x86TlbType::Unified, x86PageSize1G, 16, 4},
+    {0xC4, 1, x86TlbType::Data, PAGE_2M4M, 32, 4},
+    {0xCA, 2, x86TlbType::Unified, PAGE_4K, 512, 4}
+};
+
+static void appendTlbLevel(std::vector<x86TlbLevelInfo>& tlbs, uint32_t level, x86TlbType type,
+    uint8_t pageSizes, uint32_t numEntries, uint32_t associativity)
+{
+    if (!numEntries)
+        return;
+    x86TlbLevelInfo tlb;
+    tlb.level = level;
+    tlb.type = type;
+    tlb.pageSizes = pageSizes;
+    tlb.numEntries = numEntries;
+    tlb.associativity = associativity;
+    tlbs.push_back(tlb);
+}
+
+static void appendTlbLevelsAMD(std::vector<x86TlbLevelInfo>& tlbs, const x86TlbFeaturesAMD::Tlb& tlb,
+    uint32_t level, uint8_t pageSizes)
+{   // Associativity 0 means that the TLB is absent
+    if (tlb.dataAssociativity)
+    {
+        appendTlbLevel(tlbs, level, x86TlbType::Data, pageSizes, tlb.dataNumEntries,
+            decodeCacheAssociativity(tlb.dataAssociativity));
+    }
+    if (tlb.instructionAssociativity)
+    {
+        appendTlbLevel(tlbs, level, x86TlbType::Instruction, pageSizes, tlb.instructionNumEntries,
+            decodeCacheAssociativity(tlb.instructionAssociativity));
+    }
+}
+
+std::vector<x86TlbLevelInfo> getTlbLevels(const x86ProcessorInfo& info)
+{
+    std::vector<x86TlbLevelInfo> tlbs;
+    for (const auto& it: info.tlbInfos)
+    {
+        const x86TlbType type = (x86TlbType)it.tlbType;
+        appendTlbLevel(tlbs, it.level,
+            (x86TlbType::LoadOnly == type || x86TlbType::StoreOnly == type) ? x86TlbType::Data : type,
+            (uint8_t)it.pageSizes, it.ways * it.numSets, it.fullyAssociative ? 0 : it.ways);
+    }
+    if (tlbs.empty() && (x86VendorId::Intel == info.vendorId))
+    {   // Legacy descriptors
+        for (uint8_t descriptor: info.l1Cache.descriptors)
+        {
+            for (const auto& it: tlbDescriptors)
+            {
+                if (it.descriptor == descriptor)
+                    appendTlbLevel(tlbs, it.level, it.type, it.pageSizes, it.numEntries, it.associativity);
+            }
+        }
+    }
+    if ((x86VendorId::AMD == info.vendorId) || (x86VendorId::Hygon == info.vendorId))
+    {   // L1 TLB associativity of Function 80000005h is the number of ways, FFh is fully associative
+        const x86L1CacheAndTlbFeaturesAMD& l1 = info.l1CacheAMD;
+        appendTlbLevel(tlbs, 1, x86TlbType::Data, x86PageSize4K, l1.tlb4K.dataNumEntries,
+            (0xFF == l1.tlb4K.dataAssociativity) ? 0 : l1.tlb4K.dataAssociativity);
+        appendTlbLevel(tlbs, 1, x86TlbType::Instruction, x86PageSize4K, l1.tlb4K.instructionNumEntries,
+            (0xFF == l1.tlb4K.instructionAssociativity) ? 0 : l1.tlb4K.instructionAssociativity);
+        appendTlbLevel(tlbs, 1, x86TlbType::Data, PAGE_2M4M, l1.tlb2And4M.dataNumEntries,
+            (0xFF == l1.tlb2And4M.dataAssociativity) ? 0 : l1.tlb2And4M.dataAssociativity);
+        appendTlbLevel(tlbs, 1, x86TlbType::Instruction, PAGE_2M4M, l1.tlb2And4M.instructionNumEntries,
+            (0xFF == l1.tlb2And4M.instructionAssociativity) ? 0 : l1.tlb2And4M.instructionAssociativity);
+        appendTlbLevelsAMD(tlbs, info.tlbAMD.l1Tlb1G, 1, x86PageSize1G);
+        appendTlbLevelsAMD(tlbs, info.tlbAMD.l2Tlb4K, 2, x86PageSize4K);
+        appendTlbLevelsAMD(tlbs, info.tlbAMD.l2Tlb2And4M, 2, PAGE_2M4M);
+        appendTlbLevelsAMD(tlbs, info.tlbAMD.l2Tlb1G, 2, x86PageSize1G);
+    }
+    std::stable_sort(tlbs.begin(), tlbs.end(),
+        [](const x86TlbLevelInfo& a, const x86TlbLevelInfo& b)
+        {
+            return a.level < b.level;
+        });
+    return tlbs;
+}
+
+#define OSXSAVE_BIT             (1 << 27)
+#define ARCH_GET_XCOMP_PERM     0x1022
+#define ARCH_REQ_XCOMP_PERM     0x1023
+#define XFEATURE_XTILEDATA      18
+
+static bool requestAmxPermission() noexcept
+{   // Linux grants AMX tile data per process, other systems enable it in XCR0
+#ifdef __linux__
+    uint64_t permitted = 0;
+    if ((0 == syscall(SYS_arch_prctl, ARCH_GET_XCOMP_PERM, &permitted)) &&
+        (permitted & x86StateTileData))
+    {
+        return true;
+    }
+    return 0 == syscall(SYS_arch_prctl, ARCH_REQ_XCOMP_PERM, XFEATURE_XTILEDATA);
+#else
+    return true;
+#endif
+}
+
+static uint64_t readEnabledStateComponents() noexcept
+{
+    uint64_t stateComponents = xgetbv(XCR_XFEATURE_ENABLED_MASK);
+    if (((stateComponents & x86StateAmx) == x86StateAmx) && !requestAmxPermission())
+        stateComponents &= ~(uint64_t)x86StateTileData;
+    return stateComponents;
+}
+
+uint64_t getEnabledStateComponents() noexcept
+{
+    CpuId cpuId;
+    readCpuId(&cpuId.eax, 0);
+    const int numIds = cpuId.eax;
+    if (numIds < 0x1)
+        return 0;
+    readCpuId(&cpuId.eax, 0x1);
+    if (!(cpuId.ecx & OSXSAVE_BIT))
+        return 0;
+    if (getCpuIdSource())
+    {   // Components supported by XSAVE
+        if (numIds < 0xD)
+            return x86StateX87 | x86StateSse;
+        readCpuIdEx(&cpuId.eax, 0xD, 0);
+        return ((uint64_t)(uint32_t)cpuId.edx << 32) | (uint32_t)cpuId.eax;
+    }
+    static const uint64_t stateComponents = readEnabledStateComponents();
+    return stateComponents;
+}
+
+void maskUnusableFeatures(x86ProcessorFeatures& features, uint64_t stateComponents) noexcept
+{
+    if ((stateComponents & (x86StateSse | x86StateAvx)) != (x86StateSse | x86StateAvx))
+    {   // VEX encoded instructions operate on YMM registers
+        features.advancedVectorExtensions = 0;
+        features.fusedMultiplyAdd = 0;
+        features.f16C = 0;
+    }
+}
+
+void maskUnusableFeatures(x86ProcessorFeaturesEx& features, uint64_t stateComponents) noexcept
+{
+    const bool avx = (stateComponents & (x86StateSse | x86StateAvx)) == (x86StateSse | x86StateAvx);
+    if (!avx)
+    {
+        features.advancedVectorExtensions2 = 0;
+        features.vectorAdvancedEncryptionStandard = 0;
+        features.vectorCarryLessMultiplication = 0;
+    }
+    if (!avx || ((stateComponents & x86StateAvx512) != x86StateAvx512))
+    {
+        features.avx512Foundation = 0;
+        features.avx512DoubleAndQuadWord = 0;
+        features.avx512IntegerFusedMultiplyAdd = 0;
+        features.avx512Prefetch = 0;
+        features.avx512ExponentialAndReciprocal = 0;
+        features.avx512ConflictDetection = 0;
+        features.avx512ByteAndWord = 0;
+        features.avx512VectorLength = 0;
+        features.avx512VectorBitManipulationInstructions = 0;
+        features.avx512VectorBitManipulationInstructions2 = 0;
+        features.avx512VectorNeuralNetworkInstructions = 0;
+        features.avx512BitAlgorithms = 0;
+        features.avx512VectorPopCountDoubleAndQuadWord = 0;
+        features.avx512NeuralNetworkInstructions4Register = 0;
+        features.avx512FusedMultiplyAdd4Register = 0;
+        features.avx512Vp2Intersect = 0;
+        features.avx512HalfPrecisionInstructions = 0;
+    }
+    if ((stateComponents & x86StateAmx) != x86StateAmx)
+    {
+        features.amxTile = 0;
+        features.amxInt8 = 0;
+        features.bfloat16 = 0;
+    }
+}
+
+#define XSAVE_LEGACY_SIZE       512     // x87 and SSE state
+#define XSAVE_HEADER_SIZE       64
+#define XSAVE_ALIGNMENT         64
+#define FXSAVE_ALIGNMENT        16
+
+x86XsaveArea getXsaveArea(const x86ProcessorInfo& info, uint64_t stateComponents)
+{
+    x86XsaveArea area = {};
+    const x86ExtendedStateInfo& state = info.extendedState;
+    const uint64_t supported = ((uint64_t)state.supportedComponentsHigh << 32) | state.supportedComponents;
+    area.stateComponents = stateComponents & supported;
+    area.instruction = x86XsaveInstruction::FxSave;
+    area.size = XSAVE_LEGACY_SIZE;
+    area.alignment = FXSAVE_ALIGNMENT;
+    if (!info.features.xsaveRestore || !area.stateComponents)
+        return area;
+    // Standard format places components at fixed offsets
+    area.standardSize = XSAVE_LEGACY_SIZE + XSAVE_HEADER_SIZE;
+    uint32_t compactedSize = area.standardSize;
+    for (uint32_t component = 2; component < X86_MAX_STATE_COMPONENTS; ++component)
+    {
+        const x86StateComponentInfo& stateComponent = info.stateComponents[component];
+        if (!(area.stateComponents & (1ull << component)) || stateComponent.supervisor)
+            continue;
+        area.standardSize = std::max<uint32_t>(area.standardSize, stateComponent.offset + stateComponent.size);
+        // Compacted format packs components in index order
+        if (stateComponent.aligned)
+            compactedSize = (compactedSize + XSAVE_ALIGNMENT - 1) & ~(XSAVE_ALIGNMENT - 1);
+        compactedSize += stateComponent.size;
+    }
+    area.alignment = XSAVE_ALIGNMENT;
+    if (state.xsaveCompacted)
+    {
+        area.compactedSize = compactedSize;
+        area.instruction = x86XsaveInstruction::XSaveC;
+        area.size = compactedSize;
+    } else
+    {
+        area.instruction = state.xsaveOpt ? x86XsaveInstruction::XSaveOpt : x86XsaveInstruction::XSave;
+        area.size = area.standardSize;
+    }
+    return area;
+}
+
+const char *stringifyXsaveInstruction(x86XsaveInstruction instruction) noexcept
+{
+    static const char *names[] = {
+        "FXSAVE", "XSAVE", "XSAVEOPT", "XSAVEC"
+    };
+    return names[(uint8_t)instruction];
+}
+
+const char *stringifyStateComponent(uint32_t component) noexcept
+{
+    static const char *names[] = {
+        "x87", "SSE", "AVX", "MPX BNDREGS", "MPX BNDCSR", "AVX-512 opmask", "AVX-512 ZMM_Hi256",
+        "AVX-512 Hi16_ZMM", "PT", "PKRU", "PASID", "CET user", "CET supervisor", "HDC", "UINTR",
+        "LBR", "HWP", "AMX TILECFG", "AMX TILEDATA", "APX"
+    };
+    return (component < sizeof(names)/sizeof(names[0])) ? names[component] : "Unknown";
+}
+
 static_assert(sizeof(x86ProcessorFeatures) == sizeof(uint32_t) * 2,
     "x86ProcessorFeatures structure size mismatch");
 static_assert(sizeof(x86ProcessorFeaturesAMD) == sizeof(uint32_t) * 2,
     "x86ProcessorFeaturesAMD structure size mismatch");
 static_assert(sizeof(x86ProcessorFeaturesEx) == sizeof(uint32_t) * 3,
     "x86ProcessorFeaturesEx structure size mismatch");
+static_assert(sizeof(x86ExtendedStateInfo) == sizeof(uint32_t) * 8,
+    "x86ExtendedStateInfo structure size mismatch");
+static_assert(sizeof(x86StateComponentInfo) == sizeof(uint32_t) * 4,
+    "x86StateComponentInfo structure size mismatch");
 static_assert(sizeof(x86DeterministicCacheInfo) == sizeof(uint32_t) * 4,
     "x86DeterministicCacheInfo structure size mismatch");
 static_assert(sizeof(x86L1CacheAndTlbFeaturesAMD) == sizeof(uint32_t) * 4,
@@ -268,5 +885,15 @@ static_assert(sizeof(x86ThermalPowerManagementFeatures) == sizeof(uint32_t) * 3,
     "x86ThermalPowerManagementFeatures structure size mismatch");
 static_assert(sizeof(x86AdvancedPowerManagementFeatures) == sizeof(uint32_t),
     "x86AdvancedPowerManagementFeatures structure size mismatch");
+static_assert(sizeof(x86L1CacheAndTlbFeatures) == sizeof(uint32_t) * 4,
+    "x86L1CacheAndTlbFeatures structure size mismatch");
+static_assert(sizeof(x86DeterministicTlbInfo) == sizeof(uint32_t) * 4,
+    "x86DeterministicTlbInfo structure size mismatch");
+static_assert(sizeof(x86TlbFeaturesAMD) == sizeof(uint32_t) * 4,
+    "x86TlbFeaturesAMD structure size mismatch");
+static_assert(sizeof(x86L3CacheFeatures) == sizeof(uint32_t),
+    "x86L3CacheFeatures structure size mismatch");
+static_assert(sizeof(x86ExtendedApicIdAMD) == sizeof(uint32_t) * 3,
+    "x86ExtendedApicIdAMD structure size mismatch");
 static_assert(sizeof(CpuExtTopology) == sizeof(CpuId),
     "Topology structure size mismatch");
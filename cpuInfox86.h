@@ -292,24 +292,26 @@ union x86ProcessorFeaturesEx
         uint32_t enqueueStores: 1;                              // enqcmd
         uint32_t softwareGuardExtensionsLaunchConfiguration: 1; // sgx-lc
         uint32_t protectionKeysForSupervisorModePages: 1;       // pks
+        uint32_t reserved4: 2;
         uint32_t avx512NeuralNetworkInstructions4Register: 1;   // avx512-4vnniw
         uint32_t avx512FusedMultiplyAdd4Register: 1;            // avx512-4fmaps
         uint32_t fastShortRepMovsb: 1;                          // fsrm
         uint32_t userInterprocessorInterrupts: 1;               // uintr
-        uint32_t reserved4: 2;
+        uint32_t reserved5: 2;
         uint32_t avx512Vp2Intersect: 1;                         // avx512-vp2intersect
         uint32_t specialRegisterDataBufferSampling: 1;          // srdbs-ctrl
         uint32_t verwInstructionClearsCpuBuffers: 1;            // mc-clear
         uint32_t restrictedTransactionalMemoryAlwaysAbort: 1;   // rtm-always-abort
-        uint32_t reserved5: 1;
+        uint32_t reserved6: 1;
         uint32_t tsxForceAbort: 1;
         uint32_t serialize: 1;                                  // serialize
         uint32_t hybridTopology: 1;                             // hybrid
         uint32_t tsxLoadAddressTracking: 1;                     // tsxldtrk
+        uint32_t reserved7: 1;
         uint32_t platformConfiguration: 1;                      // pconfig
         uint32_t lastBranchRecords: 1;                          // lbr
         uint32_t cetIndirectBranchTracking: 1;                  // cet-ibt
-        uint32_t reserved6: 1;
+        uint32_t reserved8: 1;
         uint32_t bfloat16: 1;                                   // amx-bf16
         uint32_t avx512HalfPrecisionInstructions: 1;            // avx512-fp16
         uint32_t amxTile: 1;                                    // amx-tile
@@ -423,13 +425,125 @@ enum class x86CacheAssociativity : uint8_t
     Fully = 0xFF // AMD
 };
 
-/* L1 Cache and Translation Lookaside Buffer Features (Function 00000002h) */
+/* L1 Cache and Translation Lookaside Buffer Features (Function 00000002h).
+   Each register holds four one-byte descriptors unless bit 31 is set,
+   the lowest byte of eax is always 01h. */
 
 union x86L1CacheAndTlbFeatures
 {
+    uint8_t descriptors[16];
+
+    struct
+    {
+        uint32_t eax, ebx, ecx, edx;
+    };
+};
+
+/* Translation lookaside buffer type, load-only and store-only TLBs are
+   reported as data TLBs. */
+
+enum class x86TlbType : uint8_t
+{
+    Null, Data, Instruction, Unified, LoadOnly, StoreOnly
+};
+
+/* Page sizes supported by TLB. */
+
+enum x86PageSizeMask : uint8_t
+{
+    x86PageSize4K = 0x1,
+    x86PageSize2M = 0x2,
+    x86PageSize4M = 0x4,
+    x86PageSize1G = 0x8
 };
 
-/* Intel Deterministic Cache Parameters (Function 00000004h) */
+/* Intel Deterministic Address Translation Parameters (Function 00000018h) */
+
+union x86DeterministicTlbInfo
+{
+    struct
+    {
+        // eax
+        uint32_t maxSubleaf: 32;                            // Valid in subleaf 0 only
+        // ebx
+        uint32_t pageSizes: 4;                              // bits 3:0, x86PageSizeMask
+        uint32_t reserved: 4;                               // bits 7:4
+        uint32_t partitioning: 3;                           // bits 10:8
+        uint32_t reserved2: 5;                              // bits 15:11
+        uint32_t ways: 16;                                  // bits 31:16
+        // ecx
+        uint32_t numSets: 32;                               // bits 31:0
+        // edx
+        uint32_t tlbType: 5;                                // bits 4:0, x86TlbType
+        uint32_t level: 3;                                  // bits 7:5
+        uint32_t fullyAssociative: 1;                       // bit 8
+        uint32_t reserved3: 5;                              // bits 13:9
+        uint32_t maxAddressableIdsForLogicalProcessors: 12; // bits 25:14
+        uint32_t reserved4: 6;                              // bits 31:26
+    };
+
+    struct
+    {
+        int32_t reg[4];
+    };
+};
+
+/* Processor Extended State Enumeration (Function 0000000Dh, subleaves 0 and 1).
+   Sizes are in bytes and include the legacy region and XSAVE header. */
+
+union x86ExtendedStateInfo
+{
+    struct
+    {
+        // Subleaf 0
+        uint32_t supportedComponents: 32;                   // eax, XCR0 bits 31:0 which may be set
+        uint32_t enabledSize: 32;                           // ebx, standard format, components enabled in XCR0
+        uint32_t maxSize: 32;                               // ecx, standard format, all supported components
+        uint32_t supportedComponentsHigh: 32;               // edx, XCR0 bits 63:32
+        // Subleaf 1
+        uint32_t xsaveOpt: 1;                               // bit 0, xsaveopt
+        uint32_t xsaveCompacted: 1;                         // bit 1, xsavec
+        uint32_t xgetbvWithEcx1: 1;                         // bit 2, xgetbv1
+        uint32_t xsaveSupervisor: 1;                        // bit 3, xsaves
+        uint32_t extendedFeatureDisable: 1;                 // bit 4, xfd
+        uint32_t reserved: 27;                              // bits 31:5
+        uint32_t compactedSize: 32;                         // ebx, compacted format, XCR0 | IA32_XSS components
+        uint32_t supervisorComponents: 32;                  // ecx, IA32_XSS bits 31:0 which may be set
+        uint32_t supervisorComponentsHigh: 32;              // edx, IA32_XSS bits 63:32
+    };
+
+    struct
+    {
+        int32_t reg[8];
+    };
+};
+
+/* State component (Function 0000000Dh, subleaf is component index 2 and above). */
+
+union x86StateComponentInfo
+{
+    struct
+    {
+        uint32_t size: 32;                                  // eax
+        uint32_t offset: 32;                                // ebx, standard format, 0 for supervisor components
+        uint32_t supervisor: 1;                             // ecx bit 0, managed by IA32_XSS
+        uint32_t aligned: 1;                                // ecx bit 1, 64-byte aligned in compacted format
+        uint32_t extendedFeatureDisable: 1;                 // ecx bit 2
+        uint32_t reserved: 29;                              // bits 31:3
+        uint32_t reserved2: 32;                             // edx
+    };
+
+    struct
+    {
+        int32_t reg[4];
+    };
+};
+
+#define X86_MAX_STATE_COMPONENTS    32
+
+/* Deterministic Cache Parameters (Intel Function 00000004h, AMD Function 8000001Dh).
+   AMD reports number of sharing logical processors in the same field,
+   bits 31:26 are reserved. */
 
 union x86DeterministicCacheInfo
 {
@@ -506,6 +620,91 @@ union x86L2CacheFeatures
     uint32_t ecx;
 };
 
+/* AMD L2 TLB (Function 80000006h) and 1 GB page TLB (Function 80000019h) Features */
+
+union x86TlbFeaturesAMD
+{
+    struct
+    {
+        struct Tlb
+        {
+            uint32_t instructionNumEntries: 12;     // bits 11:0
+            uint32_t instructionAssociativity: 4;   // bits 15:12, x86CacheAssociativity
+            uint32_t dataNumEntries: 12;            // bits 27:16
+            uint32_t dataAssociativity: 4;          // bits 31:28, x86CacheAssociativity
+        } l2Tlb2And4M, l2Tlb4K, l1Tlb1G, l2Tlb1G;
+    };
+
+    struct
+    {
+        uint32_t eax, ebx;                          // Function 80000006h
+        uint32_t eax1G, ebx1G;                      // Function 80000019h
+    };
+};
+
+/* AMD L3 Cache Features (Function 80000006h) */
+
+union x86L3CacheFeatures
+{
+    struct
+    {
+        uint32_t lineSize: 8;               // In bytes
+        uint32_t linesPerTag: 4;
+        uint32_t associativity: 4;          // x86CacheAssociativity
+        uint32_t reserved: 2;
+        uint32_t cacheSize: 14;             // In 512 kilobyte units
+    };
+
+    uint32_t edx;
+};
+
+/* AMD Extended APIC ID, Compute Unit and Node Identifiers (Function 8000001Eh)
+   of the processor which executed CPUID. */
+
+union x86ExtendedApicIdAMD
+{
+    struct
+    {
+        // eax
+        uint32_t extendedApicId: 32;
+        // ebx
+        uint32_t coreId: 8;                 // Compute unit ID before family 17h
+        uint32_t threadsPerCore: 8;         // Minus one
+        uint32_t reserved: 16;
+        // ecx
+        uint32_t nodeId: 8;
+        uint32_t nodesPerProcessor: 3;      // Minus one
+        uint32_t reserved2: 21;
+    };
+
+    struct
+    {
+        uint32_t eax, ebx, ecx;
+    };
+};
+
+/* Data or unified cache summarized from deterministic or legacy leaves. */
+
+struct x86CacheLevelInfo
+{
+    uint32_t level;
+    uint32_t size;                          // In bytes
+    uint32_t lineSize;                      // In bytes
+    uint32_t associativity;                 // Number of ways, 0 if fully associative
+    uint32_t sharingLogicalProcessors;      // 0 if unknown
+};
+
+/* TLB summarized from deterministic, descriptor or AMD leaves. */
+
+struct x86TlbLevelInfo
+{
+    uint32_t level;
+    x86TlbType type;
+    uint8_t pageSizes;                      // x86PageSizeMask
+    uint32_t numEntries;
+    uint32_t associativity;                 // Number of ways, 0 if fully associative or unknown
+};
+
 /* x86 CPU description. */
 
 struct x86ProcessorInfo
@@ -521,17 +720,116 @@ struct x86ProcessorInfo
     x86ProcessorFeaturesEx extendedFeatures;
     x86ThermalPowerManagementFeatures tpmFeatures;
     x86AdvancedPowerManagementFeatures apmFeatures;
+    x86ExtendedStateInfo extendedState;
+    x86StateComponentInfo stateComponents[X86_MAX_STATE_COMPONENTS];   // Indexed by component
     union
     {
         x86L1CacheAndTlbFeatures l1Cache;
         x86L1CacheAndTlbFeaturesAMD l1CacheAMD;
     };
     x86L2CacheFeatures l2Cache;
+    x86L3CacheFeatures l3Cache;
+    x86TlbFeaturesAMD tlbAMD;
+    x86ExtendedApicIdAMD extendedApicIdAMD;
     std::vector<x86DeterministicCacheInfo> cacheInfos;
+    std::vector<x86DeterministicTlbInfo> tlbInfos;
 };
 
-/* */
+/* Source of TSC frequency, in order of preference. */
+
+enum class x86TscFrequencySource : uint8_t
+{
+    Unknown,
+    CrystalClock,       // Leaf 15h TSC/crystal ratio and nominal crystal frequency
+    BaseFrequency,      // Leaf 16h processor base frequency
+    Hypervisor,         // Leaf 40000010h TSC frequency reported by hypervisor
+    Measured            // Timed measurement against OS clock
+};
+
+struct x86TscFrequency
+{
+    uint64_t frequency; // In Hz
+    x86TscFrequencySource source;
+};
+
+/* Sections of processor information which are populated independently. */
+
+enum x86ProcessorInfoSection : uint32_t
+{
+    x86SectionVendor = 0x1,     // vendor, vendorId
+    x86SectionFeatures = 0x2,   // signature, misc, feature flags, power management, extended state
+    x86SectionBrand = 0x4,      // brand
+    x86SectionCaches = 0x8,     // l1Cache, l2Cache, l3Cache, tlbAMD, extendedApicIdAMD, cacheInfos, tlbInfos
+    x86SectionFrequency = 0x10, // frequency
+    x86SectionAll = 0x1F
+};
+
+/* Processor state components of XSAVE feature set (XCR0 bits). Instruction
+   set is usable only if OS saves its registers on context switch. */
+
+enum x86StateComponent : uint64_t
+{
+    x86StateX87 = 0x1,
+    x86StateSse = 0x2,                  // XMM registers
+    x86StateAvx = 0x4,                  // Upper halves of YMM registers
+    x86StateOpmask = 0x20,              // AVX-512 k0-k7
+    x86StateZmmHi256 = 0x40,            // Upper halves of ZMM0-ZMM15
+    x86StateHi16Zmm = 0x80,             // ZMM16-ZMM31
+    x86StateTileConfig = 0x20000,       // AMX TILECFG
+    x86StateTileData = 0x40000,         // AMX TILEDATA
+    x86StateAvx512 = x86StateOpmask | x86StateZmmHi256 | x86StateHi16Zmm,
+    x86StateAmx = x86StateTileConfig | x86StateTileData
+};
+
+/* getProcessorInfo() issues CPUID on every call, while queryProcessorInfo()
+   populates requested sections once and returns the process wide copy.
+   Sections which were not requested yet are left zero-initialized. */
 
 x86ProcessorInfo getProcessorInfo();
+const x86ProcessorInfo& queryProcessorInfo(uint32_t sections = x86SectionAll);
 uint32_t getProcessorPhysicalThreadCount() noexcept;
 uint64_t getProcessorFrequency(uint64_t period = 1000000000ull) noexcept;
+x86TscFrequency getTscFrequency(uint64_t period = 100000000ull) noexcept;
+uint32_t getDeterministicCacheSize(const x86DeterministicCacheInfo& cache) noexcept;
+bool getDataCacheLevel(const x86ProcessorInfo& info, uint32_t level, x86CacheLevelInfo& cache) noexcept;
+std::vector<x86TlbLevelInfo> getTlbLevels(const x86ProcessorInfo& info);
+
+/* State components enabled in XCR0, zero if OS doesn't support XSAVE.
+   On Linux AMX tile data is dropped unless permission is granted to the
+   process, it's requested on the first call. Recorded processors have
+   no XCR0, they are assumed to enable all components they support. */
+
+uint64_t getEnabledStateComponents() noexcept;
+
+/* Clears flags of instruction sets whose state isn't enabled,
+   leaving the view of features which can actually run. */
+
+void maskUnusableFeatures(x86ProcessorFeatures& features, uint64_t stateComponents) noexcept;
+void maskUnusableFeatures(x86ProcessorFeaturesEx& features, uint64_t stateComponents) noexcept;
+
+/* Instructions which save user state, from the least to the most efficient.
+   XSAVES is left out as it's available to the kernel only. */
+
+enum class x86XsaveInstruction : uint8_t
+{
+    FxSave,             // Legacy x87 and SSE state only
+    XSave,
+    XSaveOpt,           // Skips components which weren't modified since XRSTOR
+    XSaveC              // Compacted format, skips components in initial state
+};
+
+/* Save area of given state components for a fiber or coroutine context. */
+
+struct x86XsaveArea
+{
+    uint64_t stateComponents;           // Saved components
+    uint32_t standardSize;              // In bytes, XSAVE and XSAVEOPT layout
+    uint32_t compactedSize;             // In bytes, XSAVEC layout, 0 if not supported
+    x86XsaveInstruction instruction;    // Most efficient instruction available
+    uint32_t size;                      // In bytes, for the instruction
+    uint32_t alignment;                 // In bytes
+};
+
+x86XsaveArea getXsaveArea(const x86ProcessorInfo& info, uint64_t stateComponents);
+const char *stringifyXsaveInstruction(x86XsaveInstruction instruction) noexcept;
+const char *stringifyStateComponent(uint32_t component) noexcept;
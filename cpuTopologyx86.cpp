@@ -0,0 +1,219 @@
+#include <algorithm>
+#include "cpuTopologyx86.h"
+#include "threadAffinity.h"
+#include "cpuid.h"
+
+enum class TopologyLeaf : uint8_t
+{
+    Legacy, ExtendedTopology, ExtendedTopologyV2, ExtendedApicIdAMD
+};
+
+#define HTT_BIT         (1 << 28)
+#define TOPOEXT_BIT     (1 << 22)
+#define HYBRID_BIT      (1 << 15)
+
+static uint32_t ceilLog2(uint32_t value) noexcept
+{
+    uint32_t shift = 0;
+    while ((1u << shift) < value)
+        ++shift;
+    return shift;
+}
+
+static uint32_t bitMask(uint32_t shift) noexcept
+{
+    return shift < 32 ? (1u << shift) - 1 : ~0u;
+}
+
+static TopologyLeaf selectTopologyLeaf() noexcept
+{
+    CpuId cpuId;
+    __cpuid(&cpuId.eax, 0);
+    const int numIds = cpuId.eax;
+    if (cpuidIsVendor(CPUID_VENDOR_AMD, cpuId) || cpuidIsVendor(CPUID_VENDOR_HYGON, cpuId))
+    {   // Prefer extended APIC ID as it also provides node (die) ID
+        __cpuid(&cpuId.eax, CPUID_EXTENDED_ID);
+        if ((uint32_t)cpuId.eax >= CPUID_EXTENDED_ID + 0x1E)
+        {
+            __cpuid(&cpuId.eax, CPUID_EXTENDED_ID + 0x1);
+            if (cpuId.ecx & TOPOEXT_BIT)
+                return TopologyLeaf::ExtendedApicIdAMD;
+        }
+    }
+    if (numIds >= 0x1F)
+    {   // V2 extended topology leaf may be present but not populated
+        __cpuidex(&cpuId.eax, 0x1F, 0);
+        if (cpuId.ebx)
+            return TopologyLeaf::ExtendedTopologyV2;
+    }
+    if (numIds >= 0xB)
+    {
+        __cpuidex(&cpuId.eax, 0xB, 0);
+        if (cpuId.ebx)
+            return TopologyLeaf::ExtendedTopology;
+    }
+    return TopologyLeaf::Legacy;
+}
+
+static void decodeApicId(x86LogicalProcessor& cpu, uint32_t apicId,
+    uint32_t smtShift, uint32_t dieShift, uint32_t packageShift) noexcept
+{
+    const uint32_t packageLocalId = apicId & bitMask(packageShift);
+    cpu.x2ApicId = apicId;
+    cpu.smtId = (uint8_t)(apicId & bitMask(smtShift));
+    cpu.coreId = (uint16_t)(packageLocalId >> smtShift);
+    cpu.dieId = (uint16_t)(dieShift ? packageLocalId >> dieShift : 0);
+    cpu.packageId = (uint16_t)(packageShift < 32 ? apicId >> packageShift : 0);
+}
+
+static void readExtendedTopology(x86LogicalProcessor& cpu, int id) noexcept
+{
+    uint32_t smtShift = 0, dieShift = 0, shift = 0;
+    uint32_t x2ApicId = 0;
+    for (int level = 0; ; ++level)
+    {   // Each level reports shift to get ID of the next level type
+        CpuExtTopology topology;
+        __cpuidex((int *)&topology, id, level);
+        if ((TopologyLevelType::Invalid == topology.levelType) || !topology.numLogicalProcessors)
+            break;
+        x2ApicId = topology.x2ApicId;
+        if (TopologyLevelType::SMT == topology.levelType)
+            smtShift = topology.bitsToShiftRightX2ApicId;
+        else if (TopologyLevelType::Die == topology.levelType)
+            dieShift = shift;
+        shift = topology.bitsToShiftRightX2ApicId;
+    }
+    // The last enumerated level is followed by package
+    decodeApicId(cpu, x2ApicId, smtShift, dieShift, shift);
+}
+
+static void readExtendedApicIdAMD(x86LogicalProcessor& cpu) noexcept
+{
+    CpuId cpuId;
+    __cpuid(&cpuId.eax, CPUID_EXTENDED_ID + 0x8);
+    uint32_t packageShift = (cpuId.ecx >> 12) & 0xF; // ApicIdSize
+    if (!packageShift)
+        packageShift = ceilLog2((cpuId.ecx & 0xFF) + 1);
+    __cpuid(&cpuId.eax, CPUID_EXTENDED_ID + 0x1E);
+    const uint32_t threadsPerCore = ((cpuId.ebx >> 8) & 0xFF) + 1;
+    const uint32_t nodesPerProcessor = ((cpuId.ecx >> 8) & 0x7) + 1;
+    decodeApicId(cpu, cpuId.eax, ceilLog2(threadsPerCore), 0, packageShift);
+    // Node ID is system wide, make it relative to the package
+    cpu.dieId = (uint16_t)((cpuId.ecx & 0xFF) % nodesPerProcessor);
+}
+
+static void readLegacyTopology(x86LogicalProcessor& cpu, bool isIntel) noexcept
+{
+    CpuId cpuId;
+    __cpuid(&cpuId.eax, 0);
+    const int numIds = cpuId.eax;
+    __cpuid(&cpuId.eax, 0x1);
+    const uint32_t apicId = ((uint32_t)cpuId.ebx >> 24) & 0xFF; // bits 31:24
+    const uint32_t maxLogicalProcessors = (cpuId.edx & HTT_BIT) ? (cpuId.ebx >> 16) & 0xFF : 1;
+    uint32_t maxCores = 1;
+    if (isIntel && numIds >= 0x4)
+    {
+        __cpuidex(&cpuId.eax, 0x4, 0);
+        maxCores = (((uint32_t)cpuId.eax >> 26) & 0x3F) + 1;
+    } else if (!isIntel)
+    {
+        __cpuid(&cpuId.eax, CPUID_EXTENDED_ID);
+        if ((uint32_t)cpuId.eax >= CPUID_EXTENDED_ID + 0x8)
+        {
+            __cpuid(&cpuId.eax, CPUID_EXTENDED_ID + 0x8);
+            maxCores = (cpuId.ecx & 0xFF) + 1;
+        }
+    }
+    const uint32_t threadsPerCore = std::max(maxLogicalProcessors/maxCores, 1u);
+    decodeApicId(cpu, apicId, ceilLog2(threadsPerCore), 0, ceilLog2(maxLogicalProcessors));
+}
+
+static bool isHybrid() noexcept
+{
+    CpuId cpuId;
+    __cpuid(&cpuId.eax, 0);
+    if (cpuId.eax < 0x1A)
+        return false;
+    __cpuidex(&cpuId.eax, 0x7, 0);
+    return (cpuId.edx & HYBRID_BIT) != 0;
+}
+
+static void readCoreType(x86LogicalProcessor& cpu) noexcept
+{   // Core type in bits 31:24, native model ID in bits 23:0
+    CpuId cpuId;
+    __cpuid(&cpuId.eax, 0x1A);
+    cpu.coreType = (x86CoreType)(((uint32_t)cpuId.eax >> 24) & 0xFF);
+}
+
+static uint32_t countUnique(std::vector<uint32_t>& keys) noexcept
+{
+    std::sort(keys.begin(), keys.end());
+    return (uint32_t)(std::unique(keys.begin(), keys.end()) - keys.begin());
+}
+
+x86ProcessorTopology getProcessorTopology()
+{
+    x86ProcessorTopology topology = {};
+    CpuId cpuId;
+    __cpuid(&cpuId.eax, 0);
+    const bool isIntel = cpuidIsVendor(CPUID_VENDOR_INTEL, cpuId);
+    const TopologyLeaf leaf = selectTopologyLeaf();
+    topology.hybrid = isHybrid();
+    // Entries of processors outside of affinity mask stay invalid
+    const std::vector<uint32_t> allowed = getLogicalProcessors();
+    topology.processors.resize(allowed.back() + 1);
+    for (size_t i = 0; i < topology.processors.size(); ++i)
+        topology.processors[i].processor = (uint16_t)i;
+    runOnEachProcessor(
+        [&topology, leaf, isIntel](uint32_t processor, bool pinned)
+        {   // APIC ID should be read on the processor itself
+            x86LogicalProcessor& cpu = topology.processors[processor];
+            cpu.processor = (uint16_t)processor;
+            cpu.valid = pinned;
+            if (!pinned)
+                return;
+            switch (leaf)
+            {
+            case TopologyLeaf::ExtendedTopologyV2:
+                readExtendedTopology(cpu, 0x1F);
+                break;
+            case TopologyLeaf::ExtendedTopology:
+                readExtendedTopology(cpu, 0xB);
+                break;
+            case TopologyLeaf::ExtendedApicIdAMD:
+                readExtendedApicIdAMD(cpu);
+                break;
+            default:
+                readLegacyTopology(cpu, isIntel);
+            }
+            if (topology.hybrid)
+                readCoreType(cpu);
+        });
+    std::vector<uint32_t> packages, dies, cores;
+    for (const auto& cpu: topology.processors)
+    {
+        if (!cpu.valid)
+            continue;
+        packages.push_back(cpu.packageId);
+        dies.push_back(((uint32_t)cpu.packageId << 16) | cpu.dieId);
+        cores.push_back(((uint32_t)cpu.packageId << 16) | cpu.coreId);
+        ++topology.numLogicalProcessors;
+    }
+    topology.numPackages = countUnique(packages);
+    topology.numDies = countUnique(dies);
+    topology.numCores = countUnique(cores);
+    return topology;
+}
+
+const char *stringifyCoreType(x86CoreType type) noexcept
+{
+    switch (type)
+    {
+    case x86CoreType::Efficient: return "Efficient";
+    case x86CoreType::Performance: return "Performance";
+    default: return "Unknown";
+    }
+}
+
+static_assert(sizeof(x86LogicalProcessor) == 16,
+    "x86LogicalProcessor structure size mismatch");
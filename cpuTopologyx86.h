@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/* Core type of hybrid processors (Function 0000001Ah). */
+
+enum class x86CoreType : uint8_t
+{
+    Unknown = 0,            // Not hybrid or not enumerated
+    Efficient = 0x20,       // Intel Atom (E-core)
+    Performance = 0x40      // Intel Core (P-core)
+};
+
+/* Placement of a logical processor decoded from its (x2)APIC ID.
+   Die and core IDs are relative to the package, SMT ID is relative to the core. */
+
+struct x86LogicalProcessor
+{
+    uint32_t x2ApicId;
+    uint16_t processor;         // OS logical processor index
+    uint16_t packageId;
+    uint16_t dieId;
+    uint16_t coreId;
+    uint8_t smtId;
+    uint8_t valid;              // Worker has been pinned to processor
+    x86CoreType coreType;
+    uint8_t reserved;
+};
+
+/* Topology of the whole system, one entry per logical processor. */
+
+struct x86ProcessorTopology
+{
+    uint32_t numPackages;
+    uint32_t numDies;
+    uint32_t numCores;
+    uint32_t numLogicalProcessors;
+    bool hybrid;                // Core types are enumerated
+    std::vector<x86LogicalProcessor> processors; // Indexed by OS logical processor index
+};
+
+/* */
+
+x86ProcessorTopology getProcessorTopology();
+const char *stringifyCoreType(x86CoreType type) noexcept;
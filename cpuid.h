@@ -1,6 +1,11 @@
 #pragma once
+#ifdef _MSC_VER
 #include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 #include <cstring>
+#include <cstdint>
 
 #define CPUID_VENDOR_INTEL      "GenuineIntel"
 #define CPUID_VENDOR_AMD        "AuthenticAMD"
@@ -16,6 +21,135 @@ struct CpuId
     int eax, ebx, ecx, edx;
 };
 
+#ifndef _MSC_VER
+// MSVC-compatible CPUID intrinsics for GCC and Clang
+inline void __cpuidex(int info[4], int leaf, int subleaf) noexcept
+{
+    __asm__ __volatile__("cpuid"
+        : "=a"(info[0]), "=b"(info[1]), "=c"(info[2]), "=d"(info[3])
+        : "a"(leaf), "c"(subleaf));
+}
+
+inline void __cpuid(int info[4], int leaf) noexcept
+{
+    __cpuidex(info, leaf, 0);
+}
+#endif // !_MSC_VER
+
+/* Source of recorded CPUID results, which replaces CPUID instruction
+   for decoding on the thread where it is installed. */
+
+class CpuIdSource
+{
+public:
+    virtual ~CpuIdSource() {}
+    virtual void read(int info[4], int leaf, int subleaf) const noexcept = 0;
+};
+
+struct CpuIdReplayState
+{
+    const CpuIdSource *source;
+    uint64_t generation;        // Incremented whenever source changes
+};
+
+inline CpuIdReplayState& getCpuIdReplayState() noexcept
+{
+    static thread_local CpuIdReplayState state = {nullptr, 0};
+    return state;
+}
+
+inline const CpuIdSource *getCpuIdSource() noexcept
+{
+    return getCpuIdReplayState().source;
+}
+
+inline void setCpuIdSource(const CpuIdSource *source) noexcept
+{
+    CpuIdReplayState& state = getCpuIdReplayState();
+    state.source = source;
+    ++state.generation;
+}
+
+/* Installs source for the lifetime of the scope. */
+
+class CpuIdReplayScope
+{
+public:
+    explicit CpuIdReplayScope(const CpuIdSource& source) noexcept:
+        previous(getCpuIdSource())
+    {
+        setCpuIdSource(&source);
+    }
+
+    ~CpuIdReplayScope() { setCpuIdSource(previous); }
+
+private:
+    CpuIdReplayScope(const CpuIdReplayScope&) = delete;
+    CpuIdReplayScope& operator=(const CpuIdReplayScope&) = delete;
+    const CpuIdSource *previous;
+};
+
+/* Suspends installed source for the lifetime of the scope, so that
+   CPUID is read from the processor which executes it. */
+
+class CpuIdHostScope
+{
+public:
+    CpuIdHostScope() noexcept:
+        previous(getCpuIdSource())
+    {
+        if (previous)
+            setCpuIdSource(nullptr);
+    }
+
+    ~CpuIdHostScope()
+    {
+        if (previous)
+            setCpuIdSource(previous);
+    }
+
+private:
+    CpuIdHostScope(const CpuIdHostScope&) = delete;
+    CpuIdHostScope& operator=(const CpuIdHostScope&) = delete;
+    const CpuIdSource *previous;
+};
+
+/* CPUID of the installed source or of the processor which executes it.
+   Leaves without subleaves are recorded with subleaf 0. */
+
+inline void readCpuIdEx(int info[4], int leaf, int subleaf) noexcept
+{
+    const CpuIdSource *source = getCpuIdSource();
+    if (source)
+        source->read(info, leaf, subleaf);
+    else
+        __cpuidex(info, leaf, subleaf);
+}
+
+inline void readCpuId(int info[4], int leaf) noexcept
+{
+    readCpuIdEx(info, leaf, 0);
+}
+
+/* Extended control register, XCR0 reports state components enabled by OS.
+   Requires CPUID.1:ECX.OSXSAVE, otherwise the instruction faults. */
+
+#define XCR_XFEATURE_ENABLED_MASK   0
+
+#ifdef _MSC_VER
+inline uint64_t xgetbv(uint32_t xcr) noexcept
+{
+    return _xgetbv(xcr);
+}
+#else
+inline uint64_t xgetbv(uint32_t xcr) noexcept
+{   // Intrinsic would require XSAVE target for the translation unit
+    uint32_t eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(xcr));
+    return ((uint64_t)edx << 32) | eax;
+}
+#endif // _MSC_VER
+
 inline bool cpuidIsVendor(const char *vendor,
     const CpuId& cpuId) noexcept
 {   
@@ -25,3 +159,22 @@ inline bool cpuidIsVendor(const char *vendor,
     const int ascii[3] = {cpuId.ebx, cpuId.edx, cpuId.ecx};
     return 0 == strncmp((const char *)ascii, vendor, sizeof(ascii));
 }
+
+/* Extended Topology Enumeration (Functions 0000000Bh, 0000001Fh) */
+
+enum TopologyLevelType : uint8_t
+{
+    Invalid, SMT, Core, Module, Tile, Die
+};
+
+struct CpuExtTopology
+{
+    uint32_t bitsToShiftRightX2ApicId: 5;
+    uint32_t reserved: 27;
+    uint32_t numLogicalProcessors: 16;
+    uint32_t reserved2: 16;
+    uint32_t levelNumber: 8;
+    uint32_t levelType: 8;
+    uint32_t reserved3: 16;
+    uint32_t x2ApicId: 32;
+};
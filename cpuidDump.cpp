@@ -0,0 +1,315 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include "cpuidDump.h"
+#include "threadAffinity.h"
+
+#define HYPERVISOR_ID       0x40000000
+#define HYPERVISOR_BIT      (1 << 31)
+#define MAX_LEAVES          0x100   // Per range
+#define MAX_SUBLEAVES       64
+
+/* How subleaves of a leaf are enumerated. */
+
+enum class SubleafRule : uint8_t
+{
+    None,               // Subleaf is ignored
+    CacheType,          // Until cache type in eax[4:0] is null
+    LevelType,          // Until level type in ecx[15:8] is invalid
+    MaxSubleaf,         // Subleaf 0 eax reports the last subleaf
+    Fixed               // Fixed number of subleaves
+};
+
+struct SubleafLeaf
+{
+    uint32_t leaf;
+    SubleafRule rule;
+    uint32_t count;     // For fixed rule
+};
+
+static const SubleafLeaf subleafLeaves[] = {
+    {0x4, SubleafRule::CacheType, 0},
+    {0x7, SubleafRule::MaxSubleaf, 0},
+    {0xB, SubleafRule::LevelType, 0},
+    {0xD, SubleafRule::Fixed, MAX_SUBLEAVES},
+    {0xF, SubleafRule::Fixed, 4},
+    {0x10, SubleafRule::Fixed, 4},
+    {0x12, SubleafRule::Fixed, 16},
+    {0x14, SubleafRule::MaxSubleaf, 0},
+    {0x17, SubleafRule::MaxSubleaf, 0},
+    {0x18, SubleafRule::MaxSubleaf, 0},
+    {0x1B, SubleafRule::Fixed, 8},
+    {0x1D, SubleafRule::MaxSubleaf, 0},
+    {0x1F, SubleafRule::LevelType, 0},
+    {0x20, SubleafRule::MaxSubleaf, 0},
+    {0x23, SubleafRule::Fixed, 8},
+    {0x24, SubleafRule::Fixed, 2},
+    {CPUID_EXTENDED_ID + 0x1D, SubleafRule::CacheType, 0},
+    {CPUID_EXTENDED_ID + 0x20, SubleafRule::Fixed, 4},
+    {CPUID_EXTENDED_ID + 0x26, SubleafRule::Fixed, 4}
+};
+
+static void appendRecord(std::vector<CpuIdDumpRecord>& records, uint32_t leaf, uint32_t subleaf,
+    const CpuId& cpuId)
+{
+    if (!cpuId.eax && !cpuId.ebx && !cpuId.ecx && !cpuId.edx)
+        return;
+    records.push_back(CpuIdDumpRecord{leaf, subleaf,
+        (uint32_t)cpuId.eax, (uint32_t)cpuId.ebx, (uint32_t)cpuId.ecx, (uint32_t)cpuId.edx});
+}
+
+static void recordLeaf(std::vector<CpuIdDumpRecord>& records, uint32_t leaf)
+{
+    SubleafRule rule = SubleafRule::None;
+    uint32_t count = 1;
+    for (const auto& it: subleafLeaves)
+    {
+        if (it.leaf == leaf)
+        {
+            rule = it.rule;
+            count = (SubleafRule::Fixed == rule) ? it.count : MAX_SUBLEAVES;
+        }
+    }
+    CpuId cpuId;
+    for (uint32_t subleaf = 0; subleaf < count; ++subleaf)
+    {
+        __cpuidex(&cpuId.eax, (int)leaf, (int)subleaf);
+        if ((SubleafRule::CacheType == rule) && !(cpuId.eax & 0x1F))
+            break;
+        if ((SubleafRule::LevelType == rule) && !(cpuId.ecx & 0xFF00))
+            break;
+        if ((SubleafRule::MaxSubleaf == rule) && !subleaf)
+            count = std::min<uint32_t>((uint32_t)cpuId.eax + 1, MAX_SUBLEAVES);
+        appendRecord(records, leaf, subleaf, cpuId);
+    }
+}
+
+static void recordRange(std::vector<CpuIdDumpRecord>& records, uint32_t base)
+{
+    CpuId cpuId;
+    __cpuid(&cpuId.eax, (int)base);
+    const uint32_t maxLeaf = (uint32_t)cpuId.eax;
+    if ((maxLeaf < base) || (maxLeaf - base >= MAX_LEAVES))
+        return; // Range is not supported
+    for (uint32_t leaf = base; leaf <= maxLeaf; ++leaf)
+        recordLeaf(records, leaf);
+}
+
+std::vector<CpuIdDumpRecord> recordCpuId()
+{
+    std::vector<CpuIdDumpRecord> records;
+    recordRange(records, 0);
+    CpuId cpuId;
+    __cpuid(&cpuId.eax, 0x1);
+    if (cpuId.ecx & HYPERVISOR_BIT)
+        recordRange(records, HYPERVISOR_ID);
+    recordRange(records, CPUID_EXTENDED_ID);
+    std::sort(records.begin(), records.end(),
+        [](const CpuIdDumpRecord& a, const CpuIdDumpRecord& b)
+        {
+            return (a.leaf != b.leaf) ? a.leaf < b.leaf : a.subleaf < b.subleaf;
+        });
+    return records;
+}
+
+bool writeCpuIdDump(const char *path)
+{
+    const std::vector<CpuIdDumpRecord> records = recordCpuId();
+    CpuIdDumpHeader header;
+    memcpy(header.magic, CPUID_DUMP_MAGIC, sizeof(header.magic));
+    header.version = CPUID_DUMP_VERSION;
+    header.numRecords = (uint32_t)records.size();
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool written = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+        (fwrite(records.data(), sizeof(CpuIdDumpRecord), records.size(), file) == records.size());
+    written = !fclose(file) && written;
+    return written;
+}
+
+CpuIdDump::CpuIdDump() noexcept:
+    view(nullptr), viewSize(0), records(nullptr), numRecords(0)
+{}
+
+CpuIdDump::~CpuIdDump()
+{
+    close();
+}
+
+bool CpuIdDump::open(const char *path) noexcept
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == file)
+        return false;
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= (LONGLONG)sizeof(CpuIdDumpHeader))
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+    {   // View keeps mapping alive
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        viewSize = view ? (uint64_t)fileSize.QuadPart : 0;
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat fileStat;
+    if (!fstat(fd, &fileStat) && S_ISREG(fileStat.st_mode) &&
+        (fileStat.st_size >= (off_t)sizeof(CpuIdDumpHeader)))
+    {   // Mapping stays valid after descriptor is closed
+        void *ptr = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED)
+        {
+            view = ptr;
+            viewSize = (uint64_t)fileStat.st_size;
+        }
+    }
+    ::close(fd);
+#endif // _WIN32
+    if (!view)
+        return false;
+    const CpuIdDumpHeader *header = (const CpuIdDumpHeader *)view;
+    if (memcmp(header->magic, CPUID_DUMP_MAGIC, sizeof(header->magic)) ||
+        (header->version != CPUID_DUMP_VERSION) ||
+        (viewSize != sizeof(CpuIdDumpHeader) + (uint64_t)header->numRecords * sizeof(CpuIdDumpRecord)))
+    {
+        close();
+        return false;
+    }
+    records = (const CpuIdDumpRecord *)(header + 1);
+    numRecords = header->numRecords;
+    return true;
+}
+
+void CpuIdDump::close() noexcept
+{
+    if (view)
+    {
+    #ifdef _WIN32
+        UnmapViewOfFile(view);
+    #else
+        munmap(view, (size_t)viewSize);
+    #endif
+    }
+    view = nullptr;
+    viewSize = 0;
+    records = nullptr;
+    numRecords = 0;
+}
+
+const CpuIdDumpRecord *CpuIdDump::find(uint32_t leaf, uint32_t subleaf) const noexcept
+{
+    const CpuIdDumpRecord *end = records + numRecords;
+    const CpuIdDumpRecord *it = std::lower_bound(records, end, std::make_pair(leaf, subleaf),
+        [](const CpuIdDumpRecord& record, const std::pair<uint32_t, uint32_t>& key)
+        {
+            return (record.leaf != key.first) ? record.leaf < key.first : record.subleaf < key.second;
+        });
+    return ((it != end) && (it->leaf == leaf) && (it->subleaf == subleaf)) ? it : nullptr;
+}
+
+void CpuIdDump::read(int info[4], int leaf, int subleaf) const noexcept
+{
+    const CpuIdDumpRecord *record = find((uint32_t)leaf, (uint32_t)subleaf);
+    if (!record)
+    {   // Subleaf is ignored by leaves which were recorded without it
+        record = find((uint32_t)leaf, 0);
+        const bool hasSubleaves = std::any_of(std::begin(subleafLeaves), std::end(subleafLeaves),
+            [leaf](const SubleafLeaf& it) { return it.leaf == (uint32_t)leaf; });
+        if (hasSubleaves)
+            record = nullptr;
+    }
+    if (record)
+    {
+        info[0] = (int)record->eax;
+        info[1] = (int)record->ebx;
+        info[2] = (int)record->ecx;
+        info[3] = (int)record->edx;
+    }
+    else
+        info[0] = info[1] = info[2] = info[3] = 0;
+}
+
+static std::vector<std::string> listDirectory(const char *directory)
+{
+    std::vector<std::string> paths;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    const std::string pattern = std::string(directory) + "\\*";
+    HANDLE find = FindFirstFileA(pattern.c_str(), &data);
+    if (INVALID_HANDLE_VALUE == find)
+        return paths;
+    do
+    {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            paths.push_back(std::string(directory) + "\\" + data.cFileName);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR *dir = opendir(directory);
+    if (!dir)
+        return paths;
+    while (const struct dirent *entry = readdir(dir))
+    {   // Directories are rejected when opened
+        if (entry->d_name[0] != '.')
+            paths.push_back(std::string(directory) + "/" + entry->d_name);
+    }
+    closedir(dir);
+#endif // _WIN32
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+std::vector<x86ProcessorDump> decodeCpuIdDumps(const char *directory, uint32_t numThreads)
+{
+    const std::vector<std::string> paths = listDirectory(directory);
+    std::vector<x86ProcessorDump> dumps(paths.size());
+    if (!numThreads)
+        numThreads = std::max(getLogicalProcessorCount(), 1u);
+    numThreads = std::min<uint32_t>(numThreads, (uint32_t)paths.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    workers.reserve(numThreads);
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        workers.emplace_back([&paths, &dumps, &next]()
+        {   // Replay source is installed per thread
+            CpuIdDump dump;
+            for (size_t i = next++; i < paths.size(); i = next++)
+            {
+                x86ProcessorDump& result = dumps[i];
+                result.path = paths[i];
+                result.valid = dump.open(paths[i].c_str());
+                if (!result.valid)
+                    continue;
+                CpuIdReplayScope scope(dump);
+                result.info = getProcessorInfo();
+                result.physicalThreadCount = getProcessorPhysicalThreadCount();
+            }
+        });
+    }
+    for (auto& worker: workers)
+        worker.join();
+    return dumps;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cpuInfox86.h"
+#include "cpuid.h"
+
+/* Binary CPUID dump: header followed by records sorted by leaf and subleaf.
+   All fields are little-endian, so that the file can be memory-mapped and
+   searched in place. Records with all registers zero are omitted. */
+
+#define CPUID_DUMP_MAGIC        "CPUIDDMP"
+#define CPUID_DUMP_VERSION      1
+
+struct CpuIdDumpHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numRecords;
+};
+
+struct CpuIdDumpRecord
+{
+    uint32_t leaf;
+    uint32_t subleaf;
+    uint32_t eax, ebx, ecx, edx;
+};
+
+/* Records CPUID leaves of the calling thread's processor. */
+
+std::vector<CpuIdDumpRecord> recordCpuId();
+bool writeCpuIdDump(const char *path);
+
+/* Memory-mapped dump. Missing records read as zeros, like invalid leaves. */
+
+class CpuIdDump: public CpuIdSource
+{
+public:
+    CpuIdDump() noexcept;
+    ~CpuIdDump();
+    bool open(const char *path) noexcept;
+    void close() noexcept;
+    bool isOpen() const noexcept { return records != nullptr; }
+    uint32_t size() const noexcept { return numRecords; }
+    const CpuIdDumpRecord *find(uint32_t leaf, uint32_t subleaf) const noexcept;
+    void read(int info[4], int leaf, int subleaf) const noexcept override;
+
+private:
+    CpuIdDump(const CpuIdDump&) = delete;
+    CpuIdDump& operator=(const CpuIdDump&) = delete;
+
+    void *view;
+    uint64_t viewSize;
+    const CpuIdDumpRecord *records;
+    uint32_t numRecords;
+};
+
+/* Decoded dump of a single host. */
+
+struct x86ProcessorDump
+{
+    std::string path;
+    bool valid;                     // File is a well-formed dump
+    x86ProcessorInfo info;
+    uint32_t physicalThreadCount;
+};
+
+/* Decodes all dumps of the directory in parallel, results are sorted by path.
+   Zero number of threads uses all logical processors. */
+
+std::vector<x86ProcessorDump> decodeCpuIdDumps(const char *directory, uint32_t numThreads = 0);
@@ -0,0 +1,405 @@
+#include "featureCatalog.h"
+#include "cpuid.h"
+
+#define FEATURE(leaf, reg, bit, name, description, vendor)\
+    {leaf, 0, x86CpuIdRegister::reg, bit, 1, name, description, x86VendorId::vendor}
+#define FEATURE_LEAF1_EDX(bit, name, description)   FEATURE(0x1, Edx, bit, name, description, Intel)
+#define FEATURE_LEAF1_ECX(bit, name, description)   FEATURE(0x1, Ecx, bit, name, description, Intel)
+#define FEATURE_LEAF7_EBX(bit, name, description)   FEATURE(0x7, Ebx, bit, name, description, Intel)
+#define FEATURE_LEAF7_ECX(bit, name, description)   FEATURE(0x7, Ecx, bit, name, description, Intel)
+#define FEATURE_LEAF7_EDX(bit, name, description)   FEATURE(0x7, Edx, bit, name, description, Intel)
+#define FEATURE_EXT1_EDX(bit, name, description)    FEATURE(CPUID_EXTENDED_ID + 0x1, Edx, bit, name, description, AMD)
+#define FEATURE_EXT1_ECX(bit, name, description)    FEATURE(CPUID_EXTENDED_ID + 0x1, Ecx, bit, name, description, AMD)
+
+/* Bits are taken from the manuals, descriptions are those of the report. */
+
+static constexpr x86FeatureInfo featureCatalog[] = {
+    // Function 00000001h
+    FEATURE_LEAF1_EDX(0, "fpu", "FPU"),
+    FEATURE_LEAF1_EDX(1, "vme", "VME"),
+    FEATURE_LEAF1_EDX(2, "de", "Debugging Extensions"),
+    FEATURE_LEAF1_EDX(3, "pse", "Page Size Extension"),
+    FEATURE_LEAF1_EDX(4, "tsc", "Timestamp Counter"),
+    FEATURE_LEAF1_EDX(5, "msr", "Model Specific Registers"),
+    FEATURE_LEAF1_EDX(6, "pae", "PAE"),
+    FEATURE_LEAF1_EDX(7, "mce", "Machine Check Exception"),
+    FEATURE_LEAF1_EDX(8, "cx8", "Compare And Exchange 8-bit"),
+    FEATURE_LEAF1_EDX(9, "apic", "APIC"),
+    FEATURE_LEAF1_EDX(11, "sep", "SysEnter/SysExit"),
+    FEATURE_LEAF1_EDX(12, "mtrr", "Memory Type Range Registers"),
+    FEATURE_LEAF1_EDX(13, "pge", "Page Global Enable"),
+    FEATURE_LEAF1_EDX(14, "mca", "Machine Check Architecture"),
+    FEATURE_LEAF1_EDX(15, "cmov", "Conditional Move"),
+    FEATURE_LEAF1_EDX(16, "pat", "Page Attribute Table"),
+    FEATURE_LEAF1_EDX(17, "pse-36", "Page Size Extension 36-bit"),
+    FEATURE_LEAF1_EDX(18, "psn", "Processor Serial Number"),
+    FEATURE_LEAF1_EDX(19, "clfsh", "Cache Line Flush"),
+    FEATURE_LEAF1_EDX(21, "ds", "Debug Store"),
+    FEATURE_LEAF1_EDX(22, "acpi", "ACPI"),
+    FEATURE_LEAF1_EDX(23, "mmx", "MMX"),
+    FEATURE_LEAF1_EDX(24, "fxsr", "FXSAVE/FXRESTOR"),
+    FEATURE_LEAF1_EDX(25, "sse", "SSE"),
+    FEATURE_LEAF1_EDX(26, "sse2", "SSE2"),
+    FEATURE_LEAF1_EDX(27, "ss", "Self Snoop"),
+    FEATURE_LEAF1_EDX(28, "htt", "Hyper Threading"),
+    FEATURE_LEAF1_EDX(29, "tm", "Thermal Monitor"),
+    FEATURE_LEAF1_EDX(30, "ia64", "IA64 Processor"),
+    FEATURE_LEAF1_EDX(31, "pbe", "Pending Break Enable"),
+    FEATURE_LEAF1_ECX(0, "sse3", "SSE3"),
+    FEATURE_LEAF1_ECX(1, "pclmulqdq", "Carry Less Multiplication"),
+    FEATURE_LEAF1_ECX(2, "dtes64", "Debug Trace And Emon Store 64-bit"),
+    FEATURE_LEAF1_ECX(3, "monitor", "Monitor"),
+    FEATURE_LEAF1_ECX(4, "ds-cpl", "CPL Qualified Debug Store"),
+    FEATURE_LEAF1_ECX(5, "vmx", "VMX"),
+    FEATURE_LEAF1_ECX(6, "smx", "SMX"),
+    FEATURE_LEAF1_ECX(7, "est", "Enhanced Speed Step"),
+    FEATURE_LEAF1_ECX(8, "tm2", "Thermal Monitor 2"),
+    FEATURE_LEAF1_ECX(9, "ssse3", "Supplemental SSE3"),
+    FEATURE_LEAF1_ECX(10, "cnxt-id", "Context ID"),
+    FEATURE_LEAF1_ECX(11, "sdbg", "Silicon Debug Interface"),
+    FEATURE_LEAF1_ECX(12, "fma", "FMA"),
+    FEATURE_LEAF1_ECX(13, "cx16", "Compare And Exchange 16-bit"),
+    FEATURE_LEAF1_ECX(14, "xtpr", "Task Priority Messages"),
+    FEATURE_LEAF1_ECX(15, "pdcm", "Performance And Debug Capability"),
+    FEATURE_LEAF1_ECX(17, "pcid", "Processor Context Identifiers"),
+    FEATURE_LEAF1_ECX(18, "dca", "Direct Cache Access"),
+    FEATURE_LEAF1_ECX(19, "sse4.1", "SSE 4.1"),
+    FEATURE_LEAF1_ECX(20, "sse4.2", "SSE 4.2"),
+    FEATURE_LEAF1_ECX(21, "x2apic", "X2 APIC"),
+    FEATURE_LEAF1_ECX(22, "movbe", "Move Big Endian"),
+    FEATURE_LEAF1_ECX(23, "popcnt", "Population Count"),
+    FEATURE_LEAF1_ECX(24, "tsc-deadline", "Timestamp Counter Deadline"),
+    FEATURE_LEAF1_ECX(25, "aes", "AES"),
+    FEATURE_LEAF1_ECX(26, "xsave", "XSAVE/XRESTOR"),
+    FEATURE_LEAF1_ECX(27, "osxsave", "OS XSAVE"),
+    FEATURE_LEAF1_ECX(28, "avx", "AVX"),
+    FEATURE_LEAF1_ECX(29, "f16c", "F16C"),
+    FEATURE_LEAF1_ECX(30, "rdrnd", "Random Number Generator"),
+    FEATURE_LEAF1_ECX(31, "hypervisor", "Hypervisor"),
+    // Function 80000001h
+    FEATURE_EXT1_EDX(0, "", "FPU"),
+    FEATURE_EXT1_EDX(1, "", "VME"),
+    FEATURE_EXT1_EDX(2, "", "Debugging Extensions"),
+    FEATURE_EXT1_EDX(3, "", "Page Size Extension"),
+    FEATURE_EXT1_EDX(4, "", "Timestamp Counter"),
+    FEATURE_EXT1_EDX(5, "", "Model Specific Registers"),
+    FEATURE_EXT1_EDX(6, "", "PAE"),
+    FEATURE_EXT1_EDX(7, "", "Machine Check Exception"),
+    FEATURE_EXT1_EDX(8, "", "Compare And Exchange 8-bit"),
+    FEATURE_EXT1_EDX(9, "", "APIC"),
+    FEATURE_EXT1_EDX(11, "syscall", "SYSCALL/SYSRET"),
+    FEATURE_EXT1_EDX(12, "", "Memory Type Range Registers"),
+    FEATURE_EXT1_EDX(13, "", "Page Global Extension"),
+    FEATURE_EXT1_EDX(14, "", "Machine Check Architecture"),
+    FEATURE_EXT1_EDX(15, "", "Conditional Move"),
+    FEATURE_EXT1_EDX(16, "", "Page Attribute Table"),
+    FEATURE_EXT1_EDX(17, "", "Page Size Extensions 36-bit"),
+    FEATURE_EXT1_EDX(19, "mp", "Multi-Processor Capable"),
+    FEATURE_EXT1_EDX(20, "nx", "No-execute Page Protection"),
+    FEATURE_EXT1_EDX(22, "mmxext", "Extended MMX"),
+    FEATURE_EXT1_EDX(23, "", "MMX"),
+    FEATURE_EXT1_EDX(24, "", "FXSAVE/FXRSTOR"),
+    FEATURE_EXT1_EDX(25, "fxsr_opt", "FXSAVE/FXRSTOR Optimization"),
+    FEATURE_EXT1_EDX(26, "pdpe1gb", "One Gigabyte Page"),
+    FEATURE_EXT1_EDX(27, "rdtscp", "Read Timestamp Counter"),
+    FEATURE_EXT1_EDX(29, "lm", "Long mode"),
+    FEATURE_EXT1_EDX(31, "3dnow", "3DNow!"),
+    FEATURE_EXT1_EDX(30, "3dnowext", "Extended 3DNow!"),
+    FEATURE_EXT1_ECX(0, "lahf_lm", "Load/Store AH Flags Legacy Mode"),
+    FEATURE_EXT1_ECX(1, "cmp_legacy", "Core Multi-processing Legacy Mode"),
+    FEATURE_EXT1_ECX(2, "svm", "Secure Virtual Machine"),
+    FEATURE_EXT1_ECX(3, "extapic", "Extended APIC Space"),
+    FEATURE_EXT1_ECX(4, "cr8_legacy", "AltMov CR8"),
+    FEATURE_EXT1_ECX(5, "abm", "Advanced Bit Manipulation"),
+    FEATURE_EXT1_ECX(6, "sse4a", "SSE 4a"),
+    FEATURE_EXT1_ECX(7, "misalignsse", "Misaligned SSE Mode"),
+    FEATURE_EXT1_ECX(8, "3dnowprefetch", "3D Now! Prefetch"),
+    FEATURE_EXT1_ECX(9, "osvw", "OS Visible Workaround"),
+    FEATURE_EXT1_ECX(10, "ibs", "Instruction Based Sampling"),
+    FEATURE_EXT1_ECX(11, "xop", "Extended Operation"),
+    FEATURE_EXT1_ECX(12, "skinit", "Security Kernel"),
+    FEATURE_EXT1_ECX(13, "wdt", "Watchdog Timer"),
+    FEATURE_EXT1_ECX(15, "lwp", "Lightweight Profiling"),
+    FEATURE_EXT1_ECX(16, "fma4", "FMA4"),
+    FEATURE_EXT1_ECX(17, "tce", "Translation Cache Extension"),
+    FEATURE_EXT1_ECX(19, "nodeid_msr", "NodeID Model Specific Registers"),
+    FEATURE_EXT1_ECX(21, "tbm", "Trailing Bit Manipulation"),
+    FEATURE_EXT1_ECX(22, "topoext", "Topology Extensions"),
+    FEATURE_EXT1_ECX(23, "perfctr_core", "Core Performance Counter"),
+    FEATURE_EXT1_ECX(24, "perfctr_nb", "NB Performance Counter "),
+    FEATURE_EXT1_ECX(26, "dbx", "Data Breakpoint Extensions"),
+    FEATURE_EXT1_ECX(27, "perftsc", "Timestamp Performance Counter"),
+    FEATURE_EXT1_ECX(28, "pcx_l2i", "L2I Cache Performance Counter"),
+    FEATURE_EXT1_ECX(29, "monitorx", "MonitorX"),
+    FEATURE_EXT1_ECX(30, "addr_mask_ext", "Address Mask Extension"),
+    // Function 00000007h, subleaf 0
+    FEATURE_LEAF7_EBX(0, "fsgsbase", "FS/GS Base Access"),
+    FEATURE_LEAF7_EBX(1, "tsc_adjust", "Timestamp Counter Adjust"),
+    FEATURE_LEAF7_EBX(2, "sgx", "Software Guard Extensions"),
+    FEATURE_LEAF7_EBX(3, "bmi1", "Bit Manipulation Instruction Set 1"),
+    FEATURE_LEAF7_EBX(4, "hle", "Hardware Lock Elision"),
+    FEATURE_LEAF7_EBX(5, "avx2", "AVX2"),
+    FEATURE_LEAF7_EBX(6, "fdp_excptn_only", "FPU Data Pointer Exception Only"),
+    FEATURE_LEAF7_EBX(7, "smep", "Supervisor Mode Execution Prevention"),
+    FEATURE_LEAF7_EBX(8, "bmi2", "Bit Manipulation Instruction Set 2"),
+    FEATURE_LEAF7_EBX(9, "erms", "Enhanced REP/MOVSB/STOSB"),
+    FEATURE_LEAF7_EBX(10, "invpcid", "Invalidate Process Context Identifier"),
+    FEATURE_LEAF7_EBX(11, "rtm", "Restricted Transactional Memory"),
+    FEATURE_LEAF7_EBX(12, "rdt-m", "Resource Director Monitoring"),
+    FEATURE_LEAF7_EBX(13, "zero_fcs_fds", "FPU CS/DS Deprecated"),
+    FEATURE_LEAF7_EBX(14, "mpx", "Memory Protection Extensions"),
+    FEATURE_LEAF7_EBX(15, "rdt-a", "Resource Director Allocation"),
+    FEATURE_LEAF7_EBX(16, "avx512-f", "AVX512 Foundation"),
+    FEATURE_LEAF7_EBX(17, "avx512-dq", "AVX512 Double/Quad Word"),
+    FEATURE_LEAF7_EBX(18, "rdseed", "Random Seed"),
+    FEATURE_LEAF7_EBX(19, "adx", "Add Carry Extensions"),
+    FEATURE_LEAF7_EBX(20, "smap", "Supervisor Mode Access Prevention"),
+    FEATURE_LEAF7_EBX(21, "avx512-ifma", "AVX512 Integer FMA"),
+    FEATURE_LEAF7_EBX(22, "pcommit", "PCOMMIT"),
+    FEATURE_LEAF7_EBX(23, "clflushopt", "Cache Line Flush Opt"),
+    FEATURE_LEAF7_EBX(24, "clwb", "Cache Line Write Back"),
+    FEATURE_LEAF7_EBX(25, "pt", "Processor Trace"),
+    FEATURE_LEAF7_EBX(26, "avx512-pf", "AVX512 Prefetch"),
+    FEATURE_LEAF7_EBX(27, "avx512-er", "AVX512 Exponential And Reciprocal"),
+    FEATURE_LEAF7_EBX(28, "avx512-cd", "AXV512 Conflict Detection"),
+    FEATURE_LEAF7_EBX(29, "sha", "SHA"),
+    FEATURE_LEAF7_EBX(30, "avx512-bw", "AVX512 Byte/Word"),
+    FEATURE_LEAF7_EBX(31, "avx512-vl", "AVX512 Vector Length"),
+    FEATURE_LEAF7_ECX(0, "prefetchwt1", "Prefetch/Write T1"),
+    FEATURE_LEAF7_ECX(1, "avx512-vbmi", "AVX512 Vector Bit Manipulation Instructions"),
+    FEATURE_LEAF7_ECX(2, "umip", "User Mode Instruction Prevention"),
+    FEATURE_LEAF7_ECX(3, "pku", "Protection Keys For User Mode Pages"),
+    FEATURE_LEAF7_ECX(4, "ospke", "PKU Enables by OS"),
+    FEATURE_LEAF7_ECX(5, "waitpkg", "User Level Monitor Wait"),
+    FEATURE_LEAF7_ECX(6, "avx512-vbmi2", "AVX512 Vector Bit Manipulation Instructions 2"),
+    FEATURE_LEAF7_ECX(7, "cet_ss", "Control Flow Enforcement Shadow Stack"),
+    FEATURE_LEAF7_ECX(8, "gfni", "Galois Field Instructions"),
+    FEATURE_LEAF7_ECX(9, "vaes", "Vector AES"),
+    FEATURE_LEAF7_ECX(10, "vpclmulqdq", "Vector Carry Less Multiplication"),
+    FEATURE_LEAF7_ECX(11, "avx512-vnni", "AVX512 Vector Neural Network Instructions"),
+    FEATURE_LEAF7_ECX(12, "avx512-bitalg", "AVX512 Bit Algorithms"),
+    FEATURE_LEAF7_ECX(13, "tme", "Total Memory Encryption"),
+    FEATURE_LEAF7_ECX(14, "avx512-vpopcntdq", "AVX512 Vector Population Count Double/Quad Word"),
+    FEATURE_LEAF7_ECX(16, "la57", "Five Level Paging"),
+    {0x7, 0, x86CpuIdRegister::Ecx, 17, 5, "mawau", "Address Width Adjust", x86VendorId::Intel},
+    FEATURE_LEAF7_ECX(22, "rdpid", "Read Processor ID"),
+    FEATURE_LEAF7_ECX(23, "kl", "Key Locker"),
+    FEATURE_LEAF7_ECX(24, "bus_lock_detect", "Bus Lock Detect"),
+    FEATURE_LEAF7_ECX(25, "cldemote", "Cache Line Demote"),
+    FEATURE_LEAF7_ECX(27, "movdiri", "Move Double Word Direct Store"),
+    FEATURE_LEAF7_ECX(28, "movdir64b", "Move 64 Bytes Direct Store"),
+    FEATURE_LEAF7_ECX(29, "enqcmd", "Enqueue Stores"),
+    FEATURE_LEAF7_ECX(30, "sgx-lc", "Software Guard Extensions Launch Configuration"),
+    FEATURE_LEAF7_ECX(31, "pks", "Protection Keys For Supervisor Mode Pages"),
+    FEATURE_LEAF7_EDX(2, "avx512-4vnniw", "AVX512 4-register Neural Network Instructions"),
+    FEATURE_LEAF7_EDX(3, "avx512-4fmaps", "AVX512 4-register FMA Single Precision"),
+    FEATURE_LEAF7_EDX(4, "fsrm", "Fast Short REP/MOVSB"),
+    FEATURE_LEAF7_EDX(5, "uintr", "User Interprocessor Interrupts"),
+    FEATURE_LEAF7_EDX(8, "avx512-vp2intersect", "AVX512 VP2 Intersect"),
+    FEATURE_LEAF7_EDX(9, "srbds-ctrl", "Special Register Data Buffer Sampling"),
+    FEATURE_LEAF7_EDX(10, "md-clear", "VERW Instruction Clears CPU Buffers"),
+    FEATURE_LEAF7_EDX(11, "rtm-always-abort", "Restricted Transactional Memory Always Abort"),
+    FEATURE_LEAF7_EDX(13, "tsx-force-abort", "TSX Force Abort"),
+    FEATURE_LEAF7_EDX(14, "serialize", "Serialize"),
+    FEATURE_LEAF7_EDX(15, "hybrid", "Hybrid Topology"),
+    FEATURE_LEAF7_EDX(16, "tsxldtrk", "TSX Load Address Tracking"),
+    FEATURE_LEAF7_EDX(18, "pconfig", "Platform Configuration"),
+    FEATURE_LEAF7_EDX(19, "lbr", "Last Branch Records"),
+    FEATURE_LEAF7_EDX(20, "cet-ibt", "CET Indirect Branch Tracking"),
+    FEATURE_LEAF7_EDX(22, "amx-bf16", "bfloat16"),
+    FEATURE_LEAF7_EDX(23, "avx512-fp16", "AVX512 FP16 Instructions"),
+    FEATURE_LEAF7_EDX(24, "amx-tile", "AMX Tile Architecture"),
+    FEATURE_LEAF7_EDX(25, "amx-int8", "AMX 8-bit Integers"),
+    FEATURE_LEAF7_EDX(26, "spec_ctrl", "Speculation Control"),
+    FEATURE_LEAF7_EDX(27, "stibp", "Single Thread Indirect Branch Predictor"),
+    FEATURE_LEAF7_EDX(28, "l1d_flush", "Level1 Data Cache Flush"),
+    FEATURE_LEAF7_EDX(29, "arch_capabilities", "Architeture Capabilities"),
+    FEATURE_LEAF7_EDX(30, "core_capabilities", "Model-Specific Core Capabilities"),
+    FEATURE_LEAF7_EDX(31, "ssbd", "Speculative Store Bypass Disable")
+};
+
+constexpr uint32_t numFeatures = sizeof(featureCatalog)/sizeof(featureCatalog[0]);
+
+static_assert(numFeatures <= FEATURE_SET_BITS, "Feature catalog doesn't fit into x86FeatureSet");
+
+/* Perfect hash: with this seed every short name lands in its own slot.
+   The seed has to be searched again when names are added. */
+
+#define FEATURE_HASH_SEED       0x00000F27
+#define FEATURE_HASH_SLOTS      2048
+#define FEATURE_SLOT_EMPTY      0xFF
+
+static_assert(numFeatures < FEATURE_SLOT_EMPTY, "Too many feature names for 8-bit slots");
+
+constexpr char normalizeFeatureChar(char c) noexcept
+{   // Separators are skipped
+    return ('-' == c || '_' == c || '.' == c) ? '\0' :
+        ('A' <= c && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+constexpr uint32_t hashFeatureName(const char *name, uint32_t seed) noexcept
+{   // FNV-1a with seeded offset basis
+    uint32_t hash = 2166136261u ^ seed;
+    for (; *name; ++name)
+    {
+        const char c = normalizeFeatureChar(*name);
+        if (c)
+            hash = (hash ^ (uint8_t)c) * 16777619u;
+    }
+    return (hash ^ (hash >> 15)) & (FEATURE_HASH_SLOTS - 1);
+}
+
+constexpr bool equalFeatureNames(const char *a, const char *b) noexcept
+{
+    while (true)
+    {
+        while (*a && !normalizeFeatureChar(*a))
+            ++a;
+        while (*b && !normalizeFeatureChar(*b))
+            ++b;
+        if (!*a || !*b)
+            return *a == *b;
+        if (normalizeFeatureChar(*a++) != normalizeFeatureChar(*b++))
+            return false;
+    }
+}
+
+struct FeatureSlots
+{
+    uint8_t index[FEATURE_HASH_SLOTS];
+};
+
+constexpr FeatureSlots buildFeatureSlots() noexcept
+{
+    FeatureSlots slots = {};
+    for (uint32_t i = 0; i < FEATURE_HASH_SLOTS; ++i)
+        slots.index[i] = FEATURE_SLOT_EMPTY;
+    for (uint32_t i = 0; i < numFeatures; ++i)
+    {
+        if (*featureCatalog[i].name)
+            slots.index[hashFeatureName(featureCatalog[i].name, FEATURE_HASH_SEED)] = (uint8_t)i;
+    }
+    return slots;
+}
+
+constexpr bool isFeatureHashPerfect() noexcept
+{   // Every name must be found in its own slot
+    for (uint32_t i = 0; i < numFeatures; ++i)
+    {
+        for (uint32_t j = i + 1; j < numFeatures; ++j)
+        {
+            if (*featureCatalog[i].name && *featureCatalog[j].name &&
+                hashFeatureName(featureCatalog[i].name, FEATURE_HASH_SEED) ==
+                hashFeatureName(featureCatalog[j].name, FEATURE_HASH_SEED))
+                return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isFeatureHashPerfect(), "Feature names collide, search for another FEATURE_HASH_SEED");
+
+
+static constexpr FeatureSlots featureSlots = buildFeatureSlots();
+
+uint32_t getFeatureCount() noexcept
+{
+    return numFeatures;
+}
+
+const x86FeatureInfo& getFeatureInfo(uint32_t index) noexcept
+{
+    return featureCatalog[index];
+}
+
+bool findProcessorFeature(const char *name, uint32_t& index) noexcept
+{
+    const uint8_t slot = featureSlots.index[hashFeatureName(name, FEATURE_HASH_SEED)];
+    if ((FEATURE_SLOT_EMPTY == slot) || !equalFeatureNames(name, featureCatalog[slot].name))
+        return false;
+    index = slot;
+    return true;
+}
+
+uint32_t x86FeatureSet::count() const noexcept
+{
+    uint32_t count = 0;
+    for (uint64_t word: words)
+    {
+    #if defined(__POPCNT__)
+        count += (uint32_t)_mm_popcnt_u64(word);
+    #else
+        // Parallel bit count in 64-bit lanes
+        word = word - ((word >> 1) & 0x5555555555555555ull);
+        word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+        word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        count += (uint32_t)((word * 0x0101010101010101ull) >> 56);
+    #endif
+    }
+    return count;
+}
+
+static uint32_t getFeatureRegister(const x86ProcessorFeatures& features, const x86ProcessorFeaturesAMD& featuresAMD,
+    const x86ProcessorFeaturesEx& extendedFeatures, const x86FeatureInfo& feature) noexcept
+{
+    switch (feature.leaf)
+    {
+    case 0x1:
+        return (x86CpuIdRegister::Edx == feature.reg) ? features.edx : features.ecx;
+    case 0x7:
+        return (x86CpuIdRegister::Ebx == feature.reg) ? extendedFeatures.ebx :
+            (x86CpuIdRegister::Ecx == feature.reg) ? extendedFeatures.ecx : extendedFeatures.edx;
+    case CPUID_EXTENDED_ID + 0x1:
+        return (x86CpuIdRegister::Edx == feature.reg) ? featuresAMD.edx : featuresAMD.ecx;
+    default:
+        return 0;
+    }
+}
+
+static x86FeatureSet decodeFeatureSet(const x86ProcessorFeatures& features, const x86ProcessorFeaturesAMD& featuresAMD,
+    const x86ProcessorFeaturesEx& extendedFeatures) noexcept
+{
+    x86FeatureSet featureSet = {};
+    for (uint32_t i = 0; i < numFeatures; ++i)
+    {
+        const x86FeatureInfo& feature = featureCatalog[i];
+        const uint32_t mask = (feature.width < 32) ? (1u << feature.width) - 1 : ~0u;
+        if ((getFeatureRegister(features, featuresAMD, extendedFeatures, feature) >> feature.bit) & mask)
+            featureSet.set(i);
+    }
+    return featureSet;
+}
+
+x86FeatureSet getFeatureSet(const x86ProcessorInfo& info) noexcept
+{
+    return decodeFeatureSet(info.features, info.featuresAMD, info.extendedFeatures);
+}
+
+x86FeatureSet getUsableFeatureSet(const x86ProcessorInfo& info) noexcept
+{
+    x86ProcessorFeatures features = info.features;
+    x86ProcessorFeaturesEx extendedFeatures = info.extendedFeatures;
+    const uint64_t stateComponents = getEnabledStateComponents();
+    maskUnusableFeatures(features, stateComponents);
+    maskUnusableFeatures(extendedFeatures, stateComponents);
+    return decodeFeatureSet(features, info.featuresAMD, extendedFeatures);
+}
+
+x86FeatureComparison compareFeatureSets(const x86FeatureSet& first, const x86FeatureSet& second) noexcept
+{
+    static const x86FeatureSet named = []()
+    {   // Mirrored flags repeat Function 00000001h on AMD only
+        x86FeatureSet features = {};
+        for (uint32_t i = 0; i < numFeatures; ++i)
+        {
+            if (*featureCatalog[i].name)
+                features.set(i);
+        }
+        return features;
+    }();
+    x86FeatureComparison comparison;
+    comparison.common = first & second & named;
+    comparison.onlyFirst = andNot(first, second) & named;
+    comparison.onlySecond = andNot(second, first) & named;
+    return comparison;
+}
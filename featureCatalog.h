@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FEATURE_SET_SSE2
+#endif
+#include "cpuInfox86.h"
+
+/* Location of a feature flag in CPUID output. */
+
+enum class x86CpuIdRegister : uint8_t
+{
+    Eax, Ebx, Ecx, Edx
+};
+
+/* Entry of the feature catalog. The catalog is ordered as the flags
+   are reported, so that it can be printed by a loop. Flags of Function
+   80000001h EDX which mirror Function 00000001h EDX have no short name,
+   queries resolve to the latter. */
+
+struct x86FeatureInfo
+{
+    uint32_t leaf;
+    uint32_t subleaf;
+    x86CpuIdRegister reg;
+    uint8_t bit;
+    uint8_t width;                  // Multi-bit fields are present if nonzero
+    const char *name;               // Short name, empty for mirrored flags
+    const char *description;
+    x86VendorId vendor;             // Vendor which defined the flag
+};
+
+#define FEATURE_SET_BITS        256
+
+uint32_t getFeatureCount() noexcept;
+const x86FeatureInfo& getFeatureInfo(uint32_t index) noexcept;
+
+/* Short names are lowercase names used by Linux and compilers (avx2,
+   sse4.1, avx512-bw, lahf_lm). Case and separators '-', '_', '.'
+   are ignored, so that avx512bw and AVX512_BW are the same name.
+   Lookup is a single probe of a compile-time perfect hash table. */
+
+bool findProcessorFeature(const char *name, uint32_t& index) noexcept;
+
+/* Fixed-width set of catalog features. */
+
+struct x86FeatureSet
+{
+#ifdef FEATURE_SET_SSE2
+    alignas(16) uint64_t words[FEATURE_SET_BITS/64];
+#else
+    uint64_t words[FEATURE_SET_BITS/64];
+#endif
+
+    bool test(uint32_t index) const noexcept
+    {
+        return (words[index/64] >> (index % 64)) & 1;
+    }
+
+    void set(uint32_t index) noexcept
+    {
+        words[index/64] |= 1ull << (index % 64);
+    }
+
+    uint32_t count() const noexcept;
+
+    bool none() const noexcept
+    {
+        return 0 == count();
+    }
+};
+
+#ifdef FEATURE_SET_SSE2
+#define FEATURE_SET_OPERATOR(op, intrinsic)\
+inline x86FeatureSet op(const x86FeatureSet& a, const x86FeatureSet& b) noexcept\
+{\
+    x86FeatureSet result;\
+    for (uint32_t i = 0; i < FEATURE_SET_BITS/64; i += 2)\
+    {\
+        const __m128i x = _mm_load_si128((const __m128i *)&a.words[i]);\
+        const __m128i y = _mm_load_si128((const __m128i *)&b.words[i]);\
+        _mm_store_si128((__m128i *)&result.words[i], intrinsic(x, y));\
+    }\
+    return result;\
+}
+#define FEATURE_ANDNOT(x, y)    _mm_andnot_si128(y, x)
+FEATURE_SET_OPERATOR(operator&, _mm_and_si128)
+FEATURE_SET_OPERATOR(operator|, _mm_or_si128)
+FEATURE_SET_OPERATOR(operator^, _mm_xor_si128)
+FEATURE_SET_OPERATOR(andNot, FEATURE_ANDNOT)
+#else
+#define FEATURE_SET_OPERATOR(op, expression)\
+inline x86FeatureSet op(const x86FeatureSet& a, const x86FeatureSet& b) noexcept\
+{\
+    x86FeatureSet result;\
+    for (uint32_t i = 0; i < FEATURE_SET_BITS/64; ++i)\
+        result.words[i] = expression;\
+    return result;\
+}
+FEATURE_SET_OPERATOR(operator&, a.words[i] & b.words[i])
+FEATURE_SET_OPERATOR(operator|, a.words[i] | b.words[i])
+FEATURE_SET_OPERATOR(operator^, a.words[i] ^ b.words[i])
+FEATURE_SET_OPERATOR(andNot, a.words[i] & ~b.words[i])
+#endif // FEATURE_SET_SSE2
+
+inline bool operator==(const x86FeatureSet& a, const x86FeatureSet& b) noexcept
+{
+    return (a ^ b).none();
+}
+
+inline bool operator!=(const x86FeatureSet& a, const x86FeatureSet& b) noexcept
+{
+    return !(a == b);
+}
+
+/* Features decoded from processor information, which may be replayed.
+   Usable set leaves out instruction sets whose state isn't enabled by OS. */
+
+x86FeatureSet getFeatureSet(const x86ProcessorInfo& info) noexcept;
+x86FeatureSet getUsableFeatureSet(const x86ProcessorInfo& info) noexcept;
+
+/* Build which requires given features runs on the host
+   if the required set is a subset of the host set. */
+
+inline bool isFeatureSetSupported(const x86FeatureSet& required, const x86FeatureSet& available) noexcept
+{
+    return andNot(required, available).none();
+}
+
+/* Flags without short name are left out of comparison. */
+
+struct x86FeatureComparison
+{
+    x86FeatureSet common;
+    x86FeatureSet onlyFirst;
+    x86FeatureSet onlySecond;
+};
+
+x86FeatureComparison compareFeatureSets(const x86FeatureSet& first, const x86FeatureSet& second) noexcept;
@@ -0,0 +1,100 @@
+#include "featureQuery.h"
+#include "cpuid.h"
+
+/* Leaves are read once, limits of basic and extended range on demand. */
+
+class FeatureLeafCache
+{
+public:
+    FeatureLeafCache() noexcept: numLeaves(0), numIds(-1), numIdsEx(-1) {}
+
+    uint32_t read(const x86FeatureInfo& feature) noexcept
+    {
+        for (uint32_t i = 0; i < numLeaves; ++i)
+        {
+            if ((leaves[i].leaf == feature.leaf) && (leaves[i].subleaf == feature.subleaf))
+                return leaves[i].reg[(uint8_t)feature.reg];
+        }
+        Leaf& leaf = leaves[numLeaves < maxLeaves ? numLeaves++ : maxLeaves - 1];
+        leaf.leaf = feature.leaf;
+        leaf.subleaf = feature.subleaf;
+        // Leaf above the limit of its range reads as zero
+        int64_t& limit = (feature.leaf & CPUID_EXTENDED_ID) ? numIdsEx : numIds;
+        if (limit < 0)
+        {
+            readCpuId(leaf.reg, (int)(feature.leaf & CPUID_EXTENDED_ID));
+            limit = (uint32_t)leaf.reg[0];
+        }
+        if (feature.leaf <= (uint64_t)limit)
+        {
+            readCpuIdEx(leaf.reg, (int)feature.leaf, (int)feature.subleaf);
+            maskUnusable(leaf);
+        } else
+            memset(leaf.reg, 0, sizeof(leaf.reg));
+        return leaf.reg[(uint8_t)feature.reg];
+    }
+
+private:
+    static constexpr uint32_t maxLeaves = 8;
+    struct Leaf
+    {
+        uint32_t leaf, subleaf;
+        int reg[4];
+    } leaves[maxLeaves];
+
+    static void maskUnusable(Leaf& leaf) noexcept
+    {   // Answer is the usable view, like that of dispatch
+        if (0x1 == leaf.leaf)
+        {
+            x86ProcessorFeatures features;
+            features.edx = leaf.reg[3];
+            features.ecx = leaf.reg[2];
+            maskUnusableFeatures(features, getEnabledStateComponents());
+            leaf.reg[2] = features.ecx;
+        } else if ((0x7 == leaf.leaf) && !leaf.subleaf)
+        {
+            x86ProcessorFeaturesEx features;
+            features.ebx = leaf.reg[1];
+            features.ecx = leaf.reg[2];
+            features.edx = leaf.reg[3];
+            maskUnusableFeatures(features, getEnabledStateComponents());
+            leaf.reg[1] = features.ebx;
+            leaf.reg[2] = features.ecx;
+            leaf.reg[3] = features.edx;
+        }
+    }
+    uint32_t numLeaves;
+    int64_t numIds, numIdsEx;
+};
+
+x86FeatureQueryResult queryProcessorFeatures(const char *names) noexcept
+{
+    constexpr uint32_t maxNameLength = 32;
+    FeatureLeafCache leaves;
+    bool missing = false;
+    const char *begin = names;
+    while (*begin)
+    {
+        const char *end = begin;
+        while (*end && (',' != *end))
+            ++end;
+        const uint32_t length = (uint32_t)(end - begin);
+        if (length)
+        {
+            char name[maxNameLength + 1];
+            uint32_t index;
+            if (length > maxNameLength)
+                return x86FeatureQueryResult::Unknown;
+            memcpy(name, begin, length);
+            name[length] = '\0';
+            if (!findProcessorFeature(name, index))
+                return x86FeatureQueryResult::Unknown;
+            const x86FeatureInfo& feature = getFeatureInfo(index);
+            const uint32_t mask = (feature.width < 32) ? (1u << feature.width) - 1 : ~0u;
+            if (!((leaves.read(feature) >> feature.bit) & mask))
+                missing = true;
+        }
+        begin = *end ? end + 1 : end;
+    }
+    return missing ? x86FeatureQueryResult::Missing : x86FeatureQueryResult::Present;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "featureCatalog.h"
+
+/* Result of the query of comma separated feature names. */
+
+enum class x86FeatureQueryResult : int
+{
+    Present = 0,        // All features are supported
+    Missing = 1,        // At least one feature is not supported
+    Unknown = 2         // At least one name is not known
+};
+
+/* Names are resolved by findProcessorFeature(). Reads only CPUID leaves
+   of requested features, so that it's cheap enough to be called from
+   scripts on every launch. */
+
+x86FeatureQueryResult queryProcessorFeatures(const char *names) noexcept;
@@ -0,0 +1,348 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include "instructionTiming.h"
+#include "coreFrequency.h"
+#include "cpuDispatchx86.h"
+#include "featureCatalog.h"
+#include "threadAffinity.h"
+
+#define CHAINS          8       // Instructions per iteration in both kernels
+#define WIDE_CHAINS     12      // Independent chains of long latency instructions
+#define BOUND_MARGIN    1.1     // Throughput this close to latency/chains is the bound
+#define ITERATIONS      20000
+#define TRIALS          5
+
+/* Empty asm makes the value opaque, so that compiler can neither
+   reassociate the chain nor fold adjacent instructions. MSVC has no
+   inline assembly on x64, but it doesn't combine these intrinsics. */
+
+#ifdef _MSC_VER
+#define TIMING_BARRIER(x, constraint)
+#else
+#define TIMING_BARRIER(x, constraint) __asm__ volatile("" : constraint(x))
+#endif
+
+#define TIMING_STEP(x, step, constraint) x = step(x); TIMING_BARRIER(x, constraint)
+
+/* Operands keep values unchanged along the chain, e.g. multiplication
+   by one or identity permutation, so that data doesn't affect timing. */
+
+struct TimingOperands
+{
+    alignas(64) int32_t zeros[16];
+    alignas(64) int32_t indices[16];    // Identity permutation of dwords
+    alignas(64) uint8_t bytes[64];      // Identity permutation of bytes
+    alignas(64) uint8_t laneBytes[64];  // Identity shuffle within 128-bit lanes
+    alignas(64) float ones[16];
+    alignas(64) float floatZeros[16];
+    uint64_t one;
+    uint64_t allOnes;
+};
+
+#define TIMING_SINK(sink, k, x) memcpy((char *)sink + (k) * sizeof(x), &x, sizeof(x))
+
+typedef void (*TimingKernelFn)(uint64_t iterations, const TimingOperands *o, void *sink);
+
+/* Chain count is fixed by the kernel, instructions with latency above
+   CHAINS cycles use wide kernels, so that they can reach their throughput. */
+
+#define DEFINE_LATENCY_KERNEL(Name, isa, type, constraint, init, operand, step)\
+X86_TARGET(isa) static void latency##Name(uint64_t iterations, const TimingOperands *o, void *sink)\
+{\
+    const auto a = operand;\
+    (void)a;\
+    type x = init;\
+    for (uint64_t i = 0; i < iterations; ++i)\
+    {\
+        TIMING_STEP(x, step, constraint); TIMING_STEP(x, step, constraint);\
+        TIMING_STEP(x, step, constraint); TIMING_STEP(x, step, constraint);\
+        TIMING_STEP(x, step, constraint); TIMING_STEP(x, step, constraint);\
+        TIMING_STEP(x, step, constraint); TIMING_STEP(x, step, constraint);\
+    }\
+    TIMING_SINK(sink, 0, x);\
+}
+
+#define DEFINE_TIMING_KERNELS(Name, isa, type, constraint, init, operand, step)\
+DEFINE_LATENCY_KERNEL(Name, isa, type, constraint, init, operand, step)\
+X86_TARGET(isa) static void throughput##Name(uint64_t iterations, const TimingOperands *o, void *sink)\
+{   /* Separate variables stay in registers, unlike an array */\
+    const auto a = operand;\
+    (void)a;\
+    type x0 = init, x1 = init, x2 = init, x3 = init, x4 = init, x5 = init, x6 = init, x7 = init;\
+    TIMING_BARRIER(x0, constraint); TIMING_BARRIER(x1, constraint);\
+    TIMING_BARRIER(x2, constraint); TIMING_BARRIER(x3, constraint);\
+    TIMING_BARRIER(x4, constraint); TIMING_BARRIER(x5, constraint);\
+    TIMING_BARRIER(x6, constraint); TIMING_BARRIER(x7, constraint);\
+    for (uint64_t i = 0; i < iterations; ++i)\
+    {\
+        TIMING_STEP(x0, step, constraint); TIMING_STEP(x1, step, constraint);\
+        TIMING_STEP(x2, step, constraint); TIMING_STEP(x3, step, constraint);\
+        TIMING_STEP(x4, step, constraint); TIMING_STEP(x5, step, constraint);\
+        TIMING_STEP(x6, step, constraint); TIMING_STEP(x7, step, constraint);\
+    }\
+    TIMING_SINK(sink, 0, x0); TIMING_SINK(sink, 1, x1); TIMING_SINK(sink, 2, x2); TIMING_SINK(sink, 3, x3);\
+    TIMING_SINK(sink, 4, x4); TIMING_SINK(sink, 5, x5); TIMING_SINK(sink, 6, x6); TIMING_SINK(sink, 7, x7);\
+}
+
+/* Twelve chains and the operand still fit in 16 vector registers. */
+
+#define DEFINE_WIDE_TIMING_KERNELS(Name, isa, type, constraint, init, operand, step)\
+DEFINE_LATENCY_KERNEL(Name, isa, type, constraint, init, operand, step)\
+X86_TARGET(isa) static void throughput##Name(uint64_t iterations, const TimingOperands *o, void *sink)\
+{\
+    const auto a = operand;\
+    (void)a;\
+    type x0 = init, x1 = init, x2 = init, x3 = init, x4 = init, x5 = init, x6 = init, x7 = init;\
+    type x8 = init, x9 = init, x10 = init, x11 = init;\
+    TIMING_BARRIER(x0, constraint); TIMING_BARRIER(x1, constraint);\
+    TIMING_BARRIER(x2, constraint); TIMING_BARRIER(x3, constraint);\
+    TIMING_BARRIER(x4, constraint); TIMING_BARRIER(x5, constraint);\
+    TIMING_BARRIER(x6, constraint); TIMING_BARRIER(x7, constraint);\
+    TIMING_BARRIER(x8, constraint); TIMING_BARRIER(x9, constraint);\
+    TIMING_BARRIER(x10, constraint); TIMING_BARRIER(x11, constraint);\
+    for (uint64_t i = 0; i < iterations; ++i)\
+    {\
+        TIMING_STEP(x0, step, constraint); TIMING_STEP(x1, step, constraint);\
+        TIMING_STEP(x2, step, constraint); TIMING_STEP(x3, step, constraint);\
+        TIMING_STEP(x4, step, constraint); TIMING_STEP(x5, step, constraint);\
+        TIMING_STEP(x6, step, constraint); TIMING_STEP(x7, step, constraint);\
+        TIMING_STEP(x8, step, constraint); TIMING_STEP(x9, step, constraint);\
+        TIMING_STEP(x10, step, constraint); TIMING_STEP(x11, step, constraint);\
+    }\
+    TIMING_SINK(sink, 0, x0); TIMING_SINK(sink, 1, x1); TIMING_SINK(sink, 2, x2); TIMING_SINK(sink, 3, x3);\
+    TIMING_SINK(sink, 4, x4); TIMING_SINK(sink, 5, x5); TIMING_SINK(sink, 6, x6); TIMING_SINK(sink, 7, x7);\
+    TIMING_SINK(sink, 8, x8); TIMING_SINK(sink, 9, x9); TIMING_SINK(sink, 10, x10); TIMING_SINK(sink, 11, x11);\
+}
+
+#define GP_INIT         o->one
+#define XMM_INIT        _mm_load_si128((const __m128i *)o->zeros)
+#define YMM_INIT        _mm256_load_si256((const __m256i *)o->zeros)
+#define YMM_FLOAT_INIT  _mm256_load_ps(o->ones)
+#define ZMM_INIT        _mm512_load_si512(o->zeros)
+#define ZMM_FLOAT_INIT  _mm512_load_ps(o->ones)
+
+// General purpose
+#define STEP_ADD(x)         (x + a)
+#define STEP_IMUL(x)        (x * a)
+#define STEP_POPCNT(x)      (uint64_t)_mm_popcnt_u64(x)
+#define STEP_LZCNT(x)       (uint64_t)_lzcnt_u64(x)
+#define STEP_TZCNT(x)       (uint64_t)_tzcnt_u64(x)
+#define STEP_CRC32(x)       (uint64_t)_mm_crc32_u64(x, a)
+#define STEP_PDEP(x)        (uint64_t)_pdep_u64(x, a)
+#define STEP_PEXT(x)        (uint64_t)_pext_u64(x, a)
+DEFINE_TIMING_KERNELS(Add, "sse2", uint64_t, "+r", GP_INIT, o->one, STEP_ADD)
+DEFINE_TIMING_KERNELS(Imul, "sse2", uint64_t, "+r", GP_INIT, o->one, STEP_IMUL)
+DEFINE_TIMING_KERNELS(Popcnt, "popcnt", uint64_t, "+r", GP_INIT, o->one, STEP_POPCNT)
+DEFINE_TIMING_KERNELS(Lzcnt, "lzcnt", uint64_t, "+r", GP_INIT, o->one, STEP_LZCNT)
+DEFINE_TIMING_KERNELS(Tzcnt, "bmi", uint64_t, "+r", GP_INIT, o->one, STEP_TZCNT)
+DEFINE_TIMING_KERNELS(Crc32, "sse4.2", uint64_t, "+r", GP_INIT, o->one, STEP_CRC32)
+DEFINE_TIMING_KERNELS(Pdep, "bmi2", uint64_t, "+r", GP_INIT, o->allOnes, STEP_PDEP)
+DEFINE_TIMING_KERNELS(Pext, "bmi2", uint64_t, "+r", GP_INIT, o->allOnes, STEP_PEXT)
+
+// 128-bit
+#define STEP_PADDD(x)       _mm_add_epi32(x, a)
+#define STEP_PMULLD(x)      _mm_mullo_epi32(x, a)
+#define STEP_PSHUFB(x)      _mm_shuffle_epi8(x, a)
+#define STEP_PCLMULQDQ(x)   _mm_clmulepi64_si128(x, a, 0)
+#define STEP_AESENC(x)      _mm_aesenc_si128(x, a)
+DEFINE_TIMING_KERNELS(Paddd, "sse2", __m128i, "+x", XMM_INIT,
+    _mm_load_si128((const __m128i *)o->zeros), STEP_PADDD)
+DEFINE_WIDE_TIMING_KERNELS(Pmulld, "sse4.1", __m128i, "+x", XMM_INIT,
+    _mm_load_si128((const __m128i *)o->zeros), STEP_PMULLD)
+DEFINE_TIMING_KERNELS(Pshufb, "ssse3", __m128i, "+x", XMM_INIT,
+    _mm_load_si128((const __m128i *)o->laneBytes), STEP_PSHUFB)
+DEFINE_TIMING_KERNELS(Pclmulqdq, "pclmul", __m128i, "+x", XMM_INIT,
+    _mm_load_si128((const __m128i *)o->zeros), STEP_PCLMULQDQ)
+DEFINE_TIMING_KERNELS(Aesenc, "aes", __m128i, "+x", XMM_INIT,
+    _mm_load_si128((const __m128i *)o->zeros), STEP_AESENC)
+
+// 256-bit
+#define STEP_VADDPS(x)      _mm256_add_ps(x, a)
+#define STEP_VMULPS(x)      _mm256_mul_ps(x, a)
+#define STEP_VDIVPS(x)      _mm256_div_ps(x, a)
+#define STEP_VSQRTPS(x)     _mm256_sqrt_ps(x)
+#define STEP_VFMADDPS(x)    _mm256_fmadd_ps(a, a, x)
+#define STEP_VPADDD(x)      _mm256_add_epi32(x, a)
+#define STEP_VPMULLD(x)     _mm256_mullo_epi32(x, a)
+#define STEP_VPSHUFB(x)     _mm256_shuffle_epi8(x, a)
+#define STEP_VPERMD(x)      _mm256_permutevar8x32_epi32(x, a)
+#define STEP_VPERMQ(x)      _mm256_permute4x64_epi64(x, 0x4E)
+#define STEP_VPGATHERDD(x)  _mm256_i32gather_epi32(o->zeros, x, 4)
+DEFINE_TIMING_KERNELS(Vaddps, "avx", __m256, "+x", YMM_FLOAT_INIT, _mm256_load_ps(o->floatZeros), STEP_VADDPS)
+DEFINE_TIMING_KERNELS(Vmulps, "avx", __m256, "+x", YMM_FLOAT_INIT, _mm256_load_ps(o->ones), STEP_VMULPS)
+DEFINE_TIMING_KERNELS(Vdivps, "avx", __m256, "+x", YMM_FLOAT_INIT, _mm256_load_ps(o->ones), STEP_VDIVPS)
+DEFINE_TIMING_KERNELS(Vsqrtps, "avx", __m256, "+x", YMM_FLOAT_INIT, 0, STEP_VSQRTPS)
+DEFINE_TIMING_KERNELS(Vfmaddps, "fma", __m256, "+x", YMM_FLOAT_INIT, _mm256_load_ps(o->floatZeros), STEP_VFMADDPS)
+DEFINE_TIMING_KERNELS(Vpaddd, "avx2", __m256i, "+x", YMM_INIT,
+    _mm256_load_si256((const __m256i *)o->zeros), STEP_VPADDD)
+DEFINE_WIDE_TIMING_KERNELS(Vpmulld, "avx2", __m256i, "+x", YMM_INIT,
+    _mm256_load_si256((const __m256i *)o->zeros), STEP_VPMULLD)
+DEFINE_TIMING_KERNELS(Vpshufb, "avx2", __m256i, "+x", YMM_INIT,
+    _mm256_load_si256((const __m256i *)o->laneBytes), STEP_VPSHUFB)
+DEFINE_TIMING_KERNELS(Vpermd, "avx2", __m256i, "+x", YMM_INIT,
+    _mm256_load_si256((const __m256i *)o->indices), STEP_VPERMD)
+DEFINE_TIMING_KERNELS(Vpermq, "avx2", __m256i, "+x", YMM_INIT, 0, STEP_VPERMQ)
+DEFINE_TIMING_KERNELS(Vpgatherdd, "avx2", __m256i, "+x", YMM_INIT, 0, STEP_VPGATHERDD)
+
+// 512-bit
+// AVX-512 intrinsics start from undefined vectors, GCC 12 takes them for uninitialized
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#define STEP_VFMADDPS_ZMM(x)    _mm512_fmadd_ps(a, a, x)
+#define STEP_VPADDD_ZMM(x)      _mm512_add_epi32(x, a)
+#define STEP_VPMULLQ_ZMM(x)     _mm512_mullo_epi64(x, a)
+#define STEP_VPTERNLOGD_ZMM(x)  _mm512_ternarylogic_epi32(x, a, a, 0x96)
+#define STEP_VPERMD_ZMM(x)      _mm512_permutexvar_epi32(a, x)
+#define STEP_VPERMB_ZMM(x)      _mm512_permutexvar_epi8(a, x)
+#define STEP_VPCOMPRESSD_ZMM(x) _mm512_maskz_compress_epi32(a, x)
+#define STEP_VPGATHERDD_ZMM(x)  _mm512_i32gather_epi32(x, o->zeros, 4)
+#define STEP_VPDPBUSD_ZMM(x)    _mm512_dpbusd_epi32(x, a, a)
+DEFINE_TIMING_KERNELS(VfmaddpsZmm, "avx512f", __m512, "+v", ZMM_FLOAT_INIT,
+    _mm512_load_ps(o->floatZeros), STEP_VFMADDPS_ZMM)
+DEFINE_TIMING_KERNELS(VpadddZmm, "avx512f", __m512i, "+v", ZMM_INIT, _mm512_load_si512(o->zeros), STEP_VPADDD_ZMM)
+DEFINE_WIDE_TIMING_KERNELS(VpmullqZmm, "avx512dq", __m512i, "+v", ZMM_INIT, _mm512_load_si512(o->zeros), STEP_VPMULLQ_ZMM)
+DEFINE_TIMING_KERNELS(VpternlogdZmm, "avx512f", __m512i, "+v", ZMM_INIT,
+    _mm512_load_si512(o->zeros), STEP_VPTERNLOGD_ZMM)
+DEFINE_TIMING_KERNELS(VpermdZmm, "avx512f", __m512i, "+v", ZMM_INIT, _mm512_load_si512(o->indices), STEP_VPERMD_ZMM)
+DEFINE_TIMING_KERNELS(VpermbZmm, "avx512vbmi", __m512i, "+v", ZMM_INIT, _mm512_load_si512(o->bytes), STEP_VPERMB_ZMM)
+DEFINE_TIMING_KERNELS(VpcompressdZmm, "avx512f", __m512i, "+v", ZMM_INIT,
+    (__mmask16)o->allOnes, STEP_VPCOMPRESSD_ZMM)
+DEFINE_TIMING_KERNELS(VpgatherddZmm, "avx512f", __m512i, "+v", ZMM_INIT, 0, STEP_VPGATHERDD_ZMM)
+DEFINE_TIMING_KERNELS(VpdpbusdZmm, "avx512vnni", __m512i, "+v", ZMM_INIT, _mm512_load_si512(o->zeros), STEP_VPDPBUSD_ZMM)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+struct InstructionTimingEntry
+{
+    const char *instruction;
+    const char *feature;
+    TimingKernelFn latency;
+    TimingKernelFn throughput;
+    uint32_t chains;            // Of throughput kernel
+};
+
+#define TIMING_ENTRY(Name, instruction, feature) {instruction, feature, latency##Name, throughput##Name, CHAINS}
+#define WIDE_TIMING_ENTRY(Name, instruction, feature)\
+    {instruction, feature, latency##Name, throughput##Name, WIDE_CHAINS}
+
+/* Feature names are those of the feature catalog. */
+
+static const InstructionTimingEntry timingCatalog[] = {
+    TIMING_ENTRY(Add, "add r64, r64", ""),
+    TIMING_ENTRY(Imul, "imul r64, r64", ""),
+    TIMING_ENTRY(Popcnt, "popcnt r64, r64", "popcnt"),
+    TIMING_ENTRY(Lzcnt, "lzcnt r64, r64", "abm"),
+    TIMING_ENTRY(Tzcnt, "tzcnt r64, r64", "bmi1"),
+    TIMING_ENTRY(Crc32, "crc32 r64, r64", "sse4.2"),
+    TIMING_ENTRY(Pdep, "pdep r64, r64, r64", "bmi2"),
+    TIMING_ENTRY(Pext, "pext r64, r64, r64", "bmi2"),
+    TIMING_ENTRY(Paddd, "paddd xmm, xmm", "sse2"),
+    WIDE_TIMING_ENTRY(Pmulld, "pmulld xmm, xmm", "sse4.1"),
+    TIMING_ENTRY(Pshufb, "pshufb xmm, xmm", "ssse3"),
+    TIMING_ENTRY(Pclmulqdq, "pclmulqdq xmm, xmm, imm8", "pclmulqdq"),
+    TIMING_ENTRY(Aesenc, "aesenc xmm, xmm", "aes"),
+    TIMING_ENTRY(Vaddps, "vaddps ymm, ymm, ymm", "avx"),
+    TIMING_ENTRY(Vmulps, "vmulps ymm, ymm, ymm", "avx"),
+    TIMING_ENTRY(Vdivps, "vdivps ymm, ymm, ymm", "avx"),
+    TIMING_ENTRY(Vsqrtps, "vsqrtps ymm, ymm", "avx"),
+    TIMING_ENTRY(Vfmaddps, "vfmadd231ps ymm, ymm, ymm", "fma"),
+    TIMING_ENTRY(Vpaddd, "vpaddd ymm, ymm, ymm", "avx2"),
+    WIDE_TIMING_ENTRY(Vpmulld, "vpmulld ymm, ymm, ymm", "avx2"),
+    TIMING_ENTRY(Vpshufb, "vpshufb ymm, ymm, ymm", "avx2"),
+    TIMING_ENTRY(Vpermd, "vpermd ymm, ymm, ymm", "avx2"),
+    TIMING_ENTRY(Vpermq, "vpermq ymm, ymm, imm8", "avx2"),
+    TIMING_ENTRY(Vpgatherdd, "vpgatherdd ymm, [ymm], ymm", "avx2"),
+    TIMING_ENTRY(VfmaddpsZmm, "vfmadd231ps zmm, zmm, zmm", "avx512-f"),
+    TIMING_ENTRY(VpadddZmm, "vpaddd zmm, zmm, zmm", "avx512-f"),
+    WIDE_TIMING_ENTRY(VpmullqZmm, "vpmullq zmm, zmm, zmm", "avx512-dq"),
+    TIMING_ENTRY(VpternlogdZmm, "vpternlogd zmm, zmm, zmm, imm8", "avx512-f"),
+    TIMING_ENTRY(VpermdZmm, "vpermd zmm, zmm, zmm", "avx512-f"),
+    TIMING_ENTRY(VpermbZmm, "vpermb zmm, zmm, zmm", "avx512-vbmi"),
+    TIMING_ENTRY(VpcompressdZmm, "vpcompressd zmm {k}{z}, zmm", "avx512-f"),
+    TIMING_ENTRY(VpgatherddZmm, "vpgatherdd zmm {k}, [zmm]", "avx512-f"),
+    TIMING_ENTRY(VpdpbusdZmm, "vpdpbusd zmm, zmm, zmm", "avx512-vnni")
+};
+
+static bool isTimingEntrySupported(const InstructionTimingEntry& entry, const x86FeatureSet& features) noexcept
+{
+    uint32_t index;
+    if (!*entry.feature)
+        return true;
+    return findProcessorFeature(entry.feature, index) && features.test(index);
+}
+
+/* Best of trials in TSC ticks per instruction. */
+
+static double timeKernel(TimingKernelFn kernel, uint32_t chains, const TimingOperands& operands)
+{
+    alignas(64) char sink[64 * WIDE_CHAINS];
+    double best = std::numeric_limits<double>::max();
+    kernel(ITERATIONS/10, &operands, sink); // Warm up
+    for (uint32_t trial = 0; trial < TRIALS; ++trial)
+    {
+        const uint64_t begin = __rdtsc();
+        kernel(ITERATIONS, &operands, sink);
+        const uint64_t end = __rdtsc();
+        best = std::min(best, (double)(end - begin)/(ITERATIONS * chains));
+    }
+    static volatile char result;
+    result = sink[0];
+    (void)result;
+    return best;
+}
+
+x86InstructionTimings measureInstructionTimings()
+{
+    x86InstructionTimings timings = {};
+    timings.tscFrequency = getTscFrequency().frequency;
+    // Operands are filled at runtime to keep them opaque to compiler
+    TimingOperands operands = {};
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        operands.indices[i] = (int32_t)i;
+        operands.ones[i] = 1.f;
+    }
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        operands.bytes[i] = (uint8_t)i;
+        operands.laneBytes[i] = (uint8_t)(i % 16);
+    }
+    operands.one = 1;
+    operands.allOnes = ~0ull;
+    const x86FeatureSet features = getUsableFeatureSet(queryProcessorInfo(x86SectionFeatures));
+    for (const auto& entry: timingCatalog)
+        timings.timings.push_back(x86InstructionTiming{entry.instruction, entry.feature, false, 0., 0., false});
+    if (!timings.tscFrequency)
+        return timings;
+    std::thread worker([&]()
+    {
+        // Clock ratio is valid only while the thread stays on one core
+        if (!setThreadAffinity(getLogicalProcessors().front()))
+            return;
+        timings.coreFrequency = measureCoreFrequency(20000000ull);
+        const double cyclesPerTick = (double)timings.coreFrequency/timings.tscFrequency;
+        for (size_t i = 0; i < timings.timings.size(); ++i)
+        {
+            const InstructionTimingEntry& entry = timingCatalog[i];
+            if (!isTimingEntrySupported(entry, features))
+                continue;
+            x86InstructionTiming& timing = timings.timings[i];
+            timing.measured = true;
+            timing.latency = timeKernel(entry.latency, CHAINS, operands) * cyclesPerTick;
+            timing.throughput = timeKernel(entry.throughput, entry.chains, operands) * cyclesPerTick;
+            timing.throughputBound = (timing.throughput * entry.chains <= timing.latency * BOUND_MARGIN);
+        }
+    });
+    worker.join();
+    return timings;
+}
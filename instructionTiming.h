@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/* Latency is measured by a chain of dependent instructions, reciprocal
+   throughput by eight independent chains, or twelve for instructions
+   with longer latency. Throughput can't be measured below latency
+   divided by the number of chains; such result is flagged as a bound.
+   Both are in core clocks. */
+
+struct x86InstructionTiming
+{
+    const char *instruction;    // Mnemonic with operand form
+    const char *feature;        // Short name of required feature, empty for x86-64 baseline
+    bool measured;              // False if the feature is not usable
+    double latency;             // In core clocks
+    double throughput;          // In core clocks per instruction
+    bool throughputBound;       // Limited by the number of chains, actual throughput may be lower
+};
+
+struct x86InstructionTimings
+{
+    uint64_t tscFrequency;      // In Hz
+    uint64_t coreFrequency;     // In Hz, effective clock during measurement
+    std::vector<x86InstructionTiming> timings;
+};
+
+/* Runs the built-in catalog on a thread pinned to the first allowed
+   logical processor. TSC ticks are converted to core clocks with the
+   effective clock measured before the catalog. Entries stay unmeasured
+   and coreFrequency is zero if the thread can't be pinned. Entries keep
+   catalog order whether measured or not, so that reports of different
+   hosts can be diffed. */
+
+x86InstructionTimings measureInstructionTimings();
@@ -0,0 +1,152 @@
+#include "isaBaseline.h"
+
+/* Features of each level on top of the previous one, from x86-64 psABI. */
+
+static const std::vector<const char *> levelFeatures[] = {
+    {},
+    {"cmov", "cx8", "fpu", "fxsr", "mmx", "sse", "sse2", "syscall", "lm"},
+    {"cx16", "lahf_lm", "popcnt", "sse3", "sse4.1", "sse4.2", "ssse3"},
+    {"avx", "avx2", "bmi1", "bmi2", "f16c", "fma", "abm", "movbe", "xsave", "osxsave"},
+    {"avx512-f", "avx512-bw", "avx512-cd", "avx512-dq", "avx512-vl"}
+};
+
+static const char *levelNames[] = {
+    "none", "x86-64", "x86-64-v2", "x86-64-v3", "x86-64-v4"
+};
+
+/* Extensions which are not part of any level. VEX and EVEX encoded ones
+   are only offered on top of the level which enables the encoding. */
+
+struct IsaExtension
+{
+    const char *name;
+    const char *option;
+    x86IsaLevel minLevel;
+};
+
+static const IsaExtension extensions[] = {
+    {"aes", "-maes", x86IsaLevel::V2},
+    {"pclmulqdq", "-mpclmul", x86IsaLevel::V2},
+    {"sha", "-msha", x86IsaLevel::V2},
+    {"rdrnd", "-mrdrnd", x86IsaLevel::V1},
+    {"rdseed", "-mrdseed", x86IsaLevel::V1},
+    {"adx", "-madx", x86IsaLevel::V1},
+    {"fsgsbase", "-mfsgsbase", x86IsaLevel::V1},
+    {"rdpid", "-mrdpid", x86IsaLevel::V1},
+    {"clflushopt", "-mclflushopt", x86IsaLevel::V1},
+    {"clwb", "-mclwb", x86IsaLevel::V1},
+    {"3dnowprefetch", "-mprfchw", x86IsaLevel::V1},
+    {"movdiri", "-mmovdiri", x86IsaLevel::V1},
+    {"movdir64b", "-mmovdir64b", x86IsaLevel::V1},
+    {"serialize", "-mserialize", x86IsaLevel::V1},
+    {"waitpkg", "-mwaitpkg", x86IsaLevel::V1},
+    {"cldemote", "-mcldemote", x86IsaLevel::V1},
+    {"sse4a", "-msse4a", x86IsaLevel::V2},
+    {"gfni", "-mgfni", x86IsaLevel::V2},
+    {"vaes", "-mvaes", x86IsaLevel::V3},
+    {"vpclmulqdq", "-mvpclmulqdq", x86IsaLevel::V3},
+    {"avx512-ifma", "-mavx512ifma", x86IsaLevel::V4},
+    {"avx512-vbmi", "-mavx512vbmi", x86IsaLevel::V4},
+    {"avx512-vbmi2", "-mavx512vbmi2", x86IsaLevel::V4},
+    {"avx512-vnni", "-mavx512vnni", x86IsaLevel::V4},
+    {"avx512-bitalg", "-mavx512bitalg", x86IsaLevel::V4},
+    {"avx512-vpopcntdq", "-mavx512vpopcntdq", x86IsaLevel::V4},
+    {"avx512-fp16", "-mavx512fp16", x86IsaLevel::V4},
+    {"amx-tile", "-mamx-tile", x86IsaLevel::V4},
+    {"amx-int8", "-mamx-int8", x86IsaLevel::V4},
+    {"amx-bf16", "-mamx-bf16", x86IsaLevel::V4}
+};
+
+static x86FeatureSet makeFeatureSet(const std::vector<const char *>& names)
+{
+    x86FeatureSet features = {};
+    for (const char *name: names)
+    {
+        uint32_t index;
+        if (findProcessorFeature(name, index))
+            features.set(index);
+    }
+    return features;
+}
+
+x86FeatureSet getIsaLevelFeatures(x86IsaLevel level)
+{   // Each level includes the previous ones
+    static const std::vector<x86FeatureSet> levels = []()
+    {
+        std::vector<x86FeatureSet> levels;
+        x86FeatureSet features = {};
+        for (const auto& names: levelFeatures)
+        {
+            features = features | makeFeatureSet(names);
+            levels.push_back(features);
+        }
+        return levels;
+    }();
+    return levels[(uint8_t)level];
+}
+
+x86IsaLevel getIsaLevel(const x86FeatureSet& features)
+{
+    x86IsaLevel level = x86IsaLevel::None;
+    for (uint8_t next = (uint8_t)x86IsaLevel::V1; next <= (uint8_t)x86IsaLevel::V4; ++next)
+    {
+        if (!isFeatureSetSupported(getIsaLevelFeatures((x86IsaLevel)next), features))
+            break;
+        level = (x86IsaLevel)next;
+    }
+    return level;
+}
+
+const char *stringifyIsaLevel(x86IsaLevel level) noexcept
+{
+    return levelNames[(uint8_t)level];
+}
+
+x86IsaBaseline getIsaBaseline(const std::vector<x86ProcessorDump>& dumps)
+{
+    x86IsaBaseline baseline;
+    baseline.numHosts = 0;
+    baseline.numInvalid = 0;
+    baseline.level = x86IsaLevel::None;
+    std::vector<x86FeatureSet> hostFeatures(dumps.size());
+    for (size_t i = 0; i < dumps.size(); ++i)
+    {
+        if (!dumps[i].valid)
+        {
+            ++baseline.numInvalid;
+            continue;
+        }
+        hostFeatures[i] = getFeatureSet(dumps[i].info);
+        baseline.common = baseline.numHosts ? baseline.common & hostFeatures[i] : hostFeatures[i];
+        ++baseline.numHosts;
+    }
+    if (!baseline.numHosts)
+        return baseline;
+    baseline.level = getIsaLevel(baseline.common);
+    if (x86IsaLevel::None != baseline.level)
+    {
+        baseline.compilerFlags = std::string("-march=") + stringifyIsaLevel(baseline.level);
+        for (const auto& extension: extensions)
+        {
+            uint32_t index;
+            if ((extension.minLevel <= baseline.level) && findProcessorFeature(extension.name, index) &&
+                baseline.common.test(index))
+            {
+                baseline.extras.push_back(extension.option);
+                baseline.compilerFlags += std::string(" ") + extension.option;
+            }
+        }
+    }
+    if (x86IsaLevel::V4 == baseline.level)
+        return baseline;
+    const x86FeatureSet next = getIsaLevelFeatures((x86IsaLevel)((uint8_t)baseline.level + 1));
+    for (size_t i = 0; i < dumps.size(); ++i)
+    {
+        if (!dumps[i].valid)
+            continue;
+        const x86FeatureSet missing = andNot(next, hostFeatures[i]);
+        if (!missing.none())
+            baseline.blockers.push_back({dumps[i].path, missing});
+    }
+    return baseline;
+}
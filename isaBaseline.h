@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "featureCatalog.h"
+#include "cpuidDump.h"
+
+/* x86-64 microarchitecture levels of the psABI. Baseline is the level
+   v1 (plain x86-64), None means the host lacks even the baseline. */
+
+enum class x86IsaLevel : uint8_t
+{
+    None, V1, V2, V3, V4
+};
+
+/* Host which lacks features of the level above the fleet baseline. */
+
+struct x86IsaBlocker
+{
+    std::string path;
+    x86FeatureSet missing;
+};
+
+struct x86IsaBaseline
+{
+    uint32_t numHosts;                  // Valid dumps
+    uint32_t numInvalid;
+    x86FeatureSet common;               // Features supported by every host
+    x86IsaLevel level;
+    std::vector<const char *> extras;   // Compiler options of extensions above the level
+    std::string compilerFlags;          // -march=x86-64-v3 -mvaes ...
+    std::vector<x86IsaBlocker> blockers;
+};
+
+x86FeatureSet getIsaLevelFeatures(x86IsaLevel level);
+x86IsaLevel getIsaLevel(const x86FeatureSet& features);
+const char *stringifyIsaLevel(x86IsaLevel level) noexcept;
+
+/* Intersects feature sets of decoded dumps. Blockers are reported
+   for the next level only, none if the fleet is at the top level. */
+
+x86IsaBaseline getIsaBaseline(const std::vector<x86ProcessorDump>& dumps);
@@ -1,12 +1,49 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <sstream>
 #include "cpuInfox86.h"
+#include "cpuDispatchx86.h"
+#include "cpuTopologyx86.h"
+#include "coreTypes.h"
+#include "cacheLine.h"
+#include "coreFrequency.h"
+#include "memoryLatency.h"
+#include "memoryBandwidth.h"
+#include "memoryCopy.h"
+#include "coreToCoreLatency.h"
+#include "affinityPlan.h"
+#include "cacheAdvisor.h"
+#include "cpuidDump.h"
+#include "featureQuery.h"
+#include "instructionTiming.h"
+#include "isaBaseline.h"
+#include "microarchitecture.h"
+#include "threadAffinity.h"
 #include "printUtils.h"
 
 void waitInit() noexcept;
 
-std::string booleanString(uint32_t value)
+static std::string hexString(uint64_t value)
 {
-    return value ? "Yes" : "No";
+    std::ostringstream stream;
+    stream << std::hex << std::showbase << value;
+    return stream.str();
+}
+
+static std::string fixedString(double value, int precision)
+{
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(precision) << value;
+    return stream.str();
+}
+
+Boolean booleanString(uint32_t value)
+{
+    return Boolean{value != 0};
 }
 
 void printProcessorSignature(const x86ProcessorSignature& signature)
@@ -17,6 +54,29 @@ void printProcessorSignature(const x86ProcessorSignature& signature)
     printLn("Processor type", signature.processorType);
     printLn("Extended model ID", signature.extendedModelId);
     printLn("Extended family ID", signature.extendedFamilyId);
+    printLn("Display family", hexString(getDisplayFamily(signature)));
+    printLn("Display model", hexString(getDisplayModel(signature)));
+}
+
+void printMicroarchitecture(const x86ProcessorInfo& info)
+{
+    const x86Microarchitecture *microarchitecture = findMicroarchitecture(info);
+    if (!microarchitecture)
+    {
+        printLn("Microarchitecture", "Unknown");
+        return;
+    }
+    printLn("Microarchitecture", microarchitecture->name);
+    printLn("AVX-512 frequency", stringifyAvx512Frequency(microarchitecture->avx512Frequency));
+    printLn("Vector width", microarchitecture->vectorWidth);
+    printLn("Store ports", microarchitecture->storePorts);
+    const uint32_t traits = getMicroarchitectureTraits(*microarchitecture);
+    const x86MicroarchitectureTrait allTraits[] = {
+        x86TraitMicrocodedPdepPext, x86TraitAvx512Downclock, x86TraitSplitVectors,
+        x86TraitSlowRepMovsb, x86TraitSlowShortRepMovsb
+    };
+    for (x86MicroarchitectureTrait trait: allTraits)
+        printLn(stringifyMicroarchitectureTrait(trait), booleanString(traits & trait));
 }
 
 void printProcessorMiscInfo(const x86ProcessorMiscInfo& info, bool isIntel)
@@ -29,6 +89,87 @@ void printProcessorMiscInfo(const x86ProcessorMiscInfo& info, bool isIntel)
     printLn("Default APIC ID", info.defaultApicId);
 }
 
+void printProcessorTopology(const x86ProcessorTopology& topology)
+{
+    printLn("Packages", topology.numPackages);
+    printLn("Dies", topology.numDies);
+    printLn("Physical cores", topology.numCores);
+    printLn("Logical processors", topology.numLogicalProcessors);
+    printLn("Hybrid", Boolean{topology.hybrid});
+    printString("");
+    if (topology.hybrid)
+    {
+        printTableHeader("Processors", {{"CPU", 8}, {"x2APIC ID", 12}, {"Package", 10},
+            {"Die", 8}, {"Core", 8}, {"SMT", 6}, {"Type", 0}});
+    } else
+    {
+        printTableHeader("Processors", {{"CPU", 8}, {"x2APIC ID", 12}, {"Package", 10},
+            {"Die", 8}, {"Core", 8}, {"SMT", 0}});
+    }
+    for (const auto& cpu: topology.processors)
+    {
+        if (cpu.valid)
+        {
+            std::vector<std::pair<std::string, int>> cells = {{std::to_string(cpu.processor), 8},
+                {std::to_string(cpu.x2ApicId), 12}, {std::to_string(cpu.packageId), 10},
+                {std::to_string(cpu.dieId), 8}, {std::to_string(cpu.coreId), 8},
+                {std::to_string(cpu.smtId), topology.hybrid ? 6 : 0}};
+            if (topology.hybrid)
+                cells.push_back({stringifyCoreType(cpu.coreType), 0});
+            printTableRow(cells);
+        }
+        else
+            printTableRow({{std::to_string(cpu.processor), 8}, {"Unavailable", 0}});
+    }
+}
+
+void printCoreTypes(const std::vector<x86CoreTypeInfo>& coreTypes)
+{
+    printTableHeader("Core types", {{"Type", 13}, {"Native model", 14}, {"Cores", 7},
+        {"CPUs", 6}, {"L1d KiB", 9}, {"L2 KiB", 9}, {"L3 KiB", 9}, {"MHz", 0}});
+    for (const auto& coreType: coreTypes)
+    {
+        std::string sizes[3] = {"-", "-", "-"};
+        for (const auto& cache: coreType.caches)
+        {
+            if ((cache.level >= 1) && (cache.level <= 3))
+                sizes[cache.level - 1] = std::to_string(cache.size/1024);
+        }
+        printTableRow({{stringifyCoreType(coreType.type), 13},
+            {hexString(coreType.nativeModelId), 14}, {std::to_string(coreType.numCores), 7},
+            {std::to_string(coreType.numLogicalProcessors), 6}, {sizes[0], 9}, {sizes[1], 9},
+            {sizes[2], 9}, {std::to_string(coreType.frequency/1000000ull), 0}});
+    }
+}
+
+void printAffinityPlans()
+{
+    const x86AffinityPolicy policies[] = {
+        x86AffinityPolicy::OnePerCore, x86AffinityPolicy::FillCacheDomain,
+        x86AffinityPolicy::AvoidSmt, x86AffinityPolicy::SpreadPackages,
+        x86AffinityPolicy::PerformanceCores, x86AffinityPolicy::EfficientCores
+    };
+    for (x86AffinityPolicy policy: policies)
+    {
+        std::string processors;
+        for (uint32_t processor: getAffinityPlan(policy).processors)
+            processors += (processors.empty() ? "" : " ") + std::to_string(processor);
+        printLn(stringifyAffinityPolicy(policy), processors);
+    }
+}
+
+const char *stringifyTscFrequencySource(x86TscFrequencySource source)
+{
+    switch (source)
+    {
+    case x86TscFrequencySource::CrystalClock: return "Crystal clock ratio";
+    case x86TscFrequencySource::BaseFrequency: return "Processor base frequency";
+    case x86TscFrequencySource::Hypervisor: return "Hypervisor";
+    case x86TscFrequencySource::Measured: return "Measured";
+    default: return "Unknown";
+    }
+}
+
 void printProcessorFrequency(const x86ProcessorFrequency& frequency)
 {
     printLn("Processor base frequency (MHz)", frequency.processorBaseFrequency);
@@ -36,219 +177,57 @@ void printProcessorFrequency(const x86ProcessorFrequency& frequency)
     printLn("Bus frequency (MHz)", frequency.busFrequency);
     constexpr uint64_t oneSecondInNanoseconds = 1000000000ull;
     // 100-200 ms is enough for precise measurement, 10-20 ms results in deviation
-    const uint64_t processorFrequency = getProcessorFrequency(oneSecondInNanoseconds/10ull);
-    printLn("Measured CPU frequency (clocks)", processorFrequency);
-}
-
-void printProcessorFeatures(const x86ProcessorFeatures& features)
-{
-    printLn("FPU", booleanString(features.floatingPointUnit));
-    printLn("VME", booleanString(features.virtualModeExtensions));
-    printLn("Debugging Extensions", booleanString(features.debuggingExtensions));
-    printLn("Page Size Extension", booleanString(features.pageSizeExtension));
-    printLn("Timestamp Counter", booleanString(features.timestampCounter));
-    printLn("Model Specific Registers", booleanString(features.modelSpecificRegisters));
-    printLn("PAE", booleanString(features.physicalAddressExtension));
-    printLn("Machine Check Exception", booleanString(features.machineCheckException));
-    printLn("Compare And Exchange 8-bit", booleanString(features.compareAndExchange8));
-    printLn("APIC", booleanString(features.advancedProgrammableInterruptController));
-    printLn("SysEnter/SysExit", booleanString(features.sysEnterSysExit));
-    printLn("Memory Type Range Registers", booleanString(features.memoryTypeRangeRegisters));
-    printLn("Page Global Enable", booleanString(features.pageGlobalEnable));
-    printLn("Machine Check Architecture", booleanString(features.machineCheckArchitecture));
-    printLn("Conditional Move", booleanString(features.conditionalMove));
-    printLn("Page Attribute Table", booleanString(features.pageAttributeTable));
-    printLn("Page Size Extension 36-bit", booleanString(features.pageSizeExtension36Bit));
-    printLn("Processor Serial Number", booleanString(features.processorSerialNumber));
-    printLn("Cache Line Flush", booleanString(features.cacheLineFlush));
-    printLn("Debug Store", booleanString(features.debugStore));
-    printLn("ACPI", booleanString(features.advancedConfigurationAndPowerInterface));
-    printLn("MMX", booleanString(features.multiMediaExtension));
-    printLn("FXSAVE/FXRESTOR", booleanString(features.fxSaveRestore));
-    printLn("SSE", booleanString(features.streamingSimdExtensions));
-    printLn("SSE2", booleanString(features.streamingSimdExtensions2));
-    printLn("Self Snoop", booleanString(features.selfSnoop));
-    printLn("Hyper Threading", booleanString(features.hyperThreading));
-    printLn("Thermal Monitor", booleanString(features.thermalMonitor));
-    printLn("IA64 Processor", booleanString(features.ia64Processor));
-    printLn("Pending Break Enable", booleanString(features.pendingBreakEnable));
-    printLn("SSE3", booleanString(features.streamingSimdExtensions3));
-    printLn("Carry Less Multiplication", booleanString(features.carryLessMultiplication));
-    printLn("Debug Trace And Emon Store 64-bit", booleanString(features.debugTraceAndEmonStore64));
-    printLn("Monitor", booleanString(features.monitor));
-    printLn("CPL Qualified Debug Store", booleanString(features.debugStoreCplQualified));
-    printLn("VMX", booleanString(features.virtualMachineExtensions));
-    printLn("SMX", booleanString(features.saferModeExtensions));
-    printLn("Enhanced Speed Step", booleanString(features.enhancedSpeedStep));
-    printLn("Thermal Monitor 2", booleanString(features.thermalMonitor2));
-    printLn("Supplemental SSE3", booleanString(features.supplementalStreamingSimdExtensions3));
-    printLn("Context ID", booleanString(features.contextId));
-    printLn("Silicon Debug Interface", booleanString(features.siliconDebugInterface));
-    printLn("FMA", booleanString(features.fusedMultiplyAdd));
-    printLn("Compare And Exchange 16-bit", booleanString(features.compareAndExchange16));
-    printLn("Task Priority Messages", booleanString(features.taskPriorityMessages));
-    printLn("Performance And Debug Capability", booleanString(features.performanceAndDebugCapability));
-    printLn("Processor Context Identifiers", booleanString(features.processorContextIdentifiers));
-    printLn("Direct Cache Access", booleanString(features.directCacheAccess));
-    printLn("SSE 4.1", booleanString(features.streamingSimdExtensions4_1));
-    printLn("SSE 4.2", booleanString(features.streamingSimdExtensions4_2));
-    printLn("X2 APIC", booleanString(features.advancedProgrammableInterruptController2));
-    printLn("Move Big Endian", booleanString(features.moveBigEndian));
-    printLn("Population Count", booleanString(features.popCount));
-    printLn("Timestamp Counter Deadline", booleanString(features.timestampCounterDeadline));
-    printLn("AES", booleanString(features.advancedEncryptionStandard));
-    printLn("XSAVE/XRESTOR", booleanString(features.xsaveRestore));
-    printLn("OS XSAVE", booleanString(features.operatingSystemXSaveRestore));
-    printLn("AVX", booleanString(features.advancedVectorExtensions));
-    printLn("F16C", booleanString(features.f16C));
-    printLn("Random Number Generator", booleanString(features.readRandom));
-    printLn("Hypervisor", booleanString(features.hypervisor));
-}
-
-void printProcessorFeatures(const x86ProcessorFeaturesAMD& features)
-{
-    printLn("FPU", booleanString(features.floatingPointUnit));
-    printLn("VME", booleanString(features.virtualModeExtensions));
-    printLn("Debugging Extensions", booleanString(features.debuggingExtensions));
-    printLn("Page Size Extension", booleanString(features.pageSizeExtension));
-    printLn("Timestamp Counter", booleanString(features.timestampCounter));
-    printLn("Model Specific Registers", booleanString(features.modelSpecificRegisters));
-    printLn("PAE", booleanString(features.physicalAddressExtension));
-    printLn("Machine Check Exception", booleanString(features.machineCheckException));
-    printLn("Compare And Exchange 8-bit", booleanString(features.compareAndExchange8));
-    printLn("APIC", booleanString(features.advancedProgrammableInterruptController));
-    printLn("SYSCALL/SYSRET", booleanString(features.sysCallSysRet));
-    printLn("Memory Type Range Registers", booleanString(features.memoryTypeRangeRegisters));
-    printLn("Page Global Extension", booleanString(features.pageGlobalExtension));
-    printLn("Machine Check Architecture", booleanString(features.machineCheckArchitecture));
-    printLn("Conditional Move", booleanString(features.conditionalMove));
-    printLn("Page Attribute Table", booleanString(features.pageAttributeTable));
-    printLn("Page Size Extensions 36-bit", booleanString(features.pageSizeExtensions36Bit));
-    printLn("Multi-Processor Capable", booleanString(features.multiprocessorCapable));
-    printLn("No-execute Page Protection", booleanString(features.noExecutePageProtection));
-    printLn("Extended MMX", booleanString(features.extendedMmx));
-    printLn("MMX", booleanString(features.multiMediaExtension));
-    printLn("FXSAVE/FXRSTOR", booleanString(features.fxSaveRestore));
-    printLn("FXSAVE/FXRSTOR Optimization", booleanString(features.fxSaveRestoreOptimization));
-    printLn("One Gigabyte Page", booleanString(features.oneGigabytePage));
-    printLn("Read Timestamp Counter", booleanString(features.readTimestampCounter));
-    printLn("Long mode", booleanString(features.longMode));
-    printLn("3DNow!", booleanString(features._3DNow));
-    printLn("Extended 3DNow!", booleanString(features.extended3DNow));
-    printLn("Load/Store AH Flags Legacy Mode", booleanString(features.loadStoreAhFlagsLegacyMode));
-    printLn("Core Multi-processing Legacy Mode", booleanString(features.coreMultiProcessingLegacyMode));
-    printLn("Secure Virtual Machine", booleanString(features.secureVirtualMachine));
-    printLn("Extended APIC Space", booleanString(features.extendedApicSpace));
-    printLn("AltMov CR8", booleanString(features.altMovCr8));
-    printLn("Advanced Bit Manipulation", booleanString(features.advancedBitManipulation));
-    printLn("SSE 4a", booleanString(features.streamingSimdExtensions4a));
-    printLn("Misaligned SSE Mode", booleanString(features.misalignedSseMode));
-    printLn("3D Now! Prefetch", booleanString(features.prefetch3DNow));
-    printLn("OS Visible Workaround", booleanString(features.operatingSystemVisibleWorkaround));
-    printLn("Instruction Based Sampling", booleanString(features.instructionBasedSampling));
-    printLn("Extended Operation", booleanString(features.extendedOperation));
-    printLn("Security Kernel", booleanString(features.securityKernel));
-    printLn("Watchdog Timer", booleanString(features.watchdogTimer));
-    printLn("Lightweight Profiling", booleanString(features.lightweightProfiling));
-    printLn("FMA4", booleanString(features.fusedMultiplyAdd4));
-    printLn("Translation Cache Extension", booleanString(features.translationCacheExtension));
-    printLn("NodeID Model Specific Registers", booleanString(features.nodeIdModelSpecificRegisters));
-    printLn("Trailing Bit Manipulation", booleanString(features.trailingBitManipulation));
-    printLn("Topology Extensions", booleanString(features.topologyExtensions));
-    printLn("Core Performance Counter", booleanString(features.corePerformanceCounter));
-    printLn("NB Performance Counter ", booleanString(features.nbPerformanceCounter));
-    printLn("Data Breakpoint Extensions", booleanString(features.dataBreakpointExtensions));
-    printLn("Timestamp Performance Counter", booleanString(features.timestampPerformanceCounter));
-    printLn("L2I Cache Performance Counter", booleanString(features.l2InstructionCachePerformanceCounter));
-    printLn("MonitorX", booleanString(features.monitorX));
-    printLn("Address Mask Extension", booleanString(features.addressMaskExtension));
-}
-
-void printExtendedProcessorFeatures(const x86ProcessorFeaturesEx& features)
-{
-    printLn("FS/GS Base Access", booleanString(features.fsGsBaseAccess));
-    printLn("Timestamp Counter Adjust", booleanString(features.timestampCounterAdjust));
-    printLn("Software Guard Extensions", booleanString(features.softwareGuardExtensions));
-    printLn("Bit Manipulation Instruction Set 1", booleanString(features.bitManipulationInstructionSet1));
-    printLn("Hardware Lock Elision", booleanString(features.hardwareLockElision));
-    printLn("AVX2", booleanString(features.advancedVectorExtensions2));
-    printLn("FPU Data Pointer Exception Only", booleanString(features.fpuDataPointerExceptionOnly));
-    printLn("Supervisor Mode Execution Prevention", booleanString(features.supervisorModeExecutionPrevention));
-    printLn("Bit Manipulation Instruction Set 2", booleanString(features.bitManipulationInstructionSet2));
-    printLn("Enhanced REP/MOVSB/STOSB", booleanString(features.enhancedRepMovsbStosb));
-    printLn("Invalidate Process Context Identifier", booleanString(features.invalidateProcessContextIdentifier));
-    printLn("Restricted Transactional Memory", booleanString(features.restrictedTransactionalMemory));
-    printLn("Resource Director Monitoring", booleanString(features.resourceDirectorMonitoring));
-    printLn("FPU CS/DS Deprecated", booleanString(features.fpuCsDsDeprecated));
-    printLn("Memory Protection Extensions", booleanString(features.memoryProtectionExtensions));
-    printLn("Resource Director Allocation", booleanString(features.resourceDirectorAllocation));
-    printLn("AVX512 Foundation", booleanString(features.avx512Foundation));
-    printLn("AVX512 Double/Quad Word", booleanString(features.avx512DoubleAndQuadWord));
-    printLn("Random Seed", booleanString(features.randomSeed));
-    printLn("Add Carry Extensions", booleanString(features.addCarryExtensions));
-    printLn("Supervisor Mode Access Prevention", booleanString(features.supervisorModeAccessPrevention));
-    printLn("AVX512 Integer FMA", booleanString(features.avx512IntegerFusedMultiplyAdd));
-    printLn("PCOMMIT", booleanString(features.persistentCommit));
-    printLn("Cache Line Flush Opt", booleanString(features.cacheLineFlushOpt));
-    printLn("Cache Line Write Back", booleanString(features.cacheLineWriteBack));
-    printLn("Processor Trace", booleanString(features.processorTrace));
-    printLn("AVX512 Prefetch", booleanString(features.avx512Prefetch));
-    printLn("AVX512 Exponential And Reciprocal", booleanString(features.avx512ExponentialAndReciprocal));
-    printLn("AXV512 Conflict Detection", booleanString(features.avx512ConflictDetection));
-    printLn("SHA", booleanString(features.secureHashAlgorithm));
-    printLn("AVX512 Byte/Word", booleanString(features.avx512ByteAndWord));
-    printLn("AVX512 Vector Length", booleanString(features.avx512VectorLength));
-    printLn("Prefetch/Write T1", booleanString(features.prefetchWriteT1));
-    printLn("AVX512 Vector Bit Manipulation Instructions", booleanString(features.avx512VectorBitManipulationInstructions));
-    printLn("User Mode Instruction Prevention", booleanString(features.userModeInstructionPrevention));
-    printLn("Protection Keys For User Mode Pages", booleanString(features.protectionKeysForUserModePages));
-    printLn("PKU Enables by OS", booleanString(features.operatingSystemEnabledPku));
-    printLn("User Level Monitor Wait", booleanString(features.userLevelMonitorWait));
-    printLn("AVX512 Vector Bit Manipulation Instructions 2", booleanString(features.avx512VectorBitManipulationInstructions2));
-    printLn("Control Flow Enforcement Shadow Stack", booleanString(features.controlFlowEnforcementShadowStack));
-    printLn("Galois Field Instructions", booleanString(features.galoisFieldInstructions));
-    printLn("Vector AES", booleanString(features.vectorAdvancedEncryptionStandard));
-    printLn("Vector Carry Less Multiplication", booleanString(features.vectorCarryLessMultiplication));
-    printLn("AVX512 Vector Neural Network Instructions", booleanString(features.avx512VectorNeuralNetworkInstructions));
-    printLn("AVX512 Bit Algorithms", booleanString(features.avx512BitAlgorithms));
-    printLn("Total Memory Encryption", booleanString(features.totalMemoryEncryption));
-    printLn("AVX512 Vector Population Count Double/Quad Word", booleanString(features.avx512VectorPopCountDoubleAndQuadWord));
-    printLn("Five Level Paging", booleanString(features.fiveLevelPaging));
-    printLn("Address Width Adjust", booleanString(features.addressWidthAdjust));
-    printLn("Read Processor ID", booleanString(features.readProcessorId));
-    printLn("Key Locker", booleanString(features.keyLocker));
-    printLn("Bus Lock Detect", booleanString(features.busLockDetect));
-    printLn("Cache Line Demote", booleanString(features.cacheLineDemote));
-    printLn("Move Double Word Direct Store", booleanString(features.moveDoubleWordDirectStore));
-    printLn("Move 64 Bytes Direct Store", booleanString(features.move64BytesDirectStore));
-    printLn("Enqueue Stores", booleanString(features.enqueueStores));
-    printLn("Software Guard Extensions Launch Configuration", booleanString(features.softwareGuardExtensionsLaunchConfiguration));
-    printLn("Protection Keys For Supervisor Mode Pages", booleanString(features.protectionKeysForSupervisorModePages));
-    printLn("AVX512 4-register Neural Network Instructions", booleanString(features.avx512NeuralNetworkInstructions4Register));
-    printLn("AVX512 4-register FMA Single Precision", booleanString(features.avx512FusedMultiplyAdd4Register));
-    printLn("Fast Short REP/MOVSB", booleanString(features.fastShortRepMovsb));
-    printLn("User Interprocessor Interrupts", booleanString(features.userInterprocessorInterrupts));
-    printLn("AVX512 VP2 Intersect", booleanString(features.avx512Vp2Intersect));
-    printLn("Special Register Data Buffer Sampling", booleanString(features.specialRegisterDataBufferSampling));
-    printLn("VERW Instruction Clears CPU Buffers", booleanString(features.verwInstructionClearsCpuBuffers));
-    printLn("Restricted Transactional Memory Always Abort", booleanString(features.restrictedTransactionalMemoryAlwaysAbort));
-    printLn("TSX Force Abort", booleanString(features.tsxForceAbort));
-    printLn("Serialize", booleanString(features.serialize));
-    printLn("Hybrid Topology", booleanString(features.hybridTopology));
-    printLn("TSX Load Address Tracking", booleanString(features.tsxLoadAddressTracking));
-    printLn("Platform Configuration", booleanString(features.platformConfiguration));
-    printLn("Last Branch Records", booleanString(features.lastBranchRecords));
-    printLn("CET Indirect Branch Tracking", booleanString(features.cetIndirectBranchTracking));
-    printLn("bfloat16", booleanString(features.bfloat16));
-    printLn("AVX512 FP16 Instructions", booleanString(features.avx512HalfPrecisionInstructions));
-    printLn("AMX Tile Architecture", booleanString(features.amxTile));
-    printLn("AMX 8-bit Integers", booleanString(features.amxInt8));
-    printLn("Speculation Control", booleanString(features.speculationControl));
-    printLn("Single Thread Indirect Branch Predictor", booleanString(features.singleThreadIndirectBranchPredictor));
-    printLn("Level1 Data Cache Flush", booleanString(features.l1DCacheFlush));
-    printLn("Architeture Capabilities", booleanString(features.architetureCapabilities));
-    printLn("Model-Specific Core Capabilities", booleanString(features.coreCapabilities));
-    printLn("Speculative Store Bypass Disable", booleanString(features.speculativeStoreBypassDisable));
+    const x86TscFrequency tscFrequency = getTscFrequency(oneSecondInNanoseconds/10ull);
+    printLn("TSC frequency (clocks)", tscFrequency.frequency);
+    printLn("TSC frequency source", stringifyTscFrequencySource(tscFrequency.source));
+}
+
+/* Catalog is ordered as the report, flags of one leaf are printed together. */
+
+void printProcessorFeatures(const x86FeatureSet& features, uint32_t leaf)
+{
+    for (uint32_t i = 0; i < getFeatureCount(); ++i)
+    {
+        const x86FeatureInfo& feature = getFeatureInfo(i);
+        if (feature.leaf == leaf)
+            printLn(feature.description, Boolean{features.test(i)});
+    }
+}
+
+void printExtendedState(const x86ProcessorInfo& info, uint64_t enabledComponents)
+{
+    const x86ExtendedStateInfo& state = info.extendedState;
+    printLn("XSAVEOPT", booleanString(state.xsaveOpt));
+    printLn("XSAVEC", booleanString(state.xsaveCompacted));
+    printLn("XGETBV With ECX = 1", booleanString(state.xgetbvWithEcx1));
+    printLn("XSAVES/XRSTORS", booleanString(state.xsaveSupervisor));
+    printLn("Extended Feature Disable", booleanString(state.extendedFeatureDisable));
+    printLn("Supported Components (XCR0)", hexString(((uint64_t)state.supportedComponentsHigh << 32) | state.supportedComponents));
+    printLn("Supported Components (IA32_XSS)", hexString(((uint64_t)state.supervisorComponentsHigh << 32) | state.supervisorComponents));
+    printLn("Enabled Components Size", state.enabledSize);
+    printLn("Maximum Size", state.maxSize);
+    printLn("Compacted Size (XCR0 | IA32_XSS)", state.compactedSize);
+    const x86XsaveArea area = getXsaveArea(info, enabledComponents);
+    printString("");
+    printString("Save area of enabled components:");
+    printLn("Components", hexString(area.stateComponents));
+    printLn("Standard size", area.standardSize);
+    printLn("Compacted size", area.compactedSize);
+    printLn("Save instruction", stringifyXsaveInstruction(area.instruction));
+    printLn("Size", area.size);
+    printLn("Alignment", area.alignment);
+    printString("");
+    printTableHeader("Components", {{"Component", 11}, {"Name", 20}, {"Size", 8}, {"Offset", 8},
+        {"Aligned", 9}, {"Supervisor", 0}});
+    for (uint32_t component = 2; component < X86_MAX_STATE_COMPONENTS; ++component)
+    {
+        const x86StateComponentInfo& stateComponent = info.stateComponents[component];
+        if (!stateComponent.size)
+            continue;
+        printTableRow({{std::to_string(component), 11}, {stringifyStateComponent(component), 20},
+            {std::to_string(stateComponent.size), 8}, {std::to_string(stateComponent.offset), 8},
+            {stateComponent.aligned ? "Yes" : "No", 9}, {stateComponent.supervisor ? "Yes" : "No", 0}});
+    }
 }
 
 void printThermalPowerManagementFeatures(const x86ThermalPowerManagementFeatures& features, bool isAMD)
@@ -343,7 +322,7 @@ const char *stringifyIntegerCacheAssociativity(uint8_t associativity)
 
 void printDeterministicCacheInfo(const x86DeterministicCacheInfo& cache)
 {
-    std::cout << stringifyCacheType(cache.cacheType) << " cache: " << std::endl << std::endl;
+    printString((std::string(stringifyCacheType(cache.cacheType)) + " cache: \n").c_str());
     printLn("System coherency line size", cache.systemCoherencyLineSize);
     printLn("Physical line partitions", cache.physicalLinePartitions);
     printLn("Associativity", stringifyIntegerCacheAssociativity(cache.associativity));
@@ -354,9 +333,9 @@ void printDeterministicCacheInfo(const x86DeterministicCacheInfo& cache)
     printLn("Write-back invalidate/invalidate", booleanString(cache.writeBackInvalidate));
     printLn("Cache inclusiveness", booleanString(cache.inclusiveness));
     printLn("Complex cache indexing", !cache.complexCacheIndexing ? "Direct mapped" : "Complex function");
+    printLn("Logical processors sharing cache", cache.maxAddressableIdsForLogicalProcessors);
 
-    const uint32_t cacheSizeInBytes = cache.associativity * cache.physicalLinePartitions *
-        cache.systemCoherencyLineSize * cache.numSets;
+    const uint32_t cacheSizeInBytes = getDeterministicCacheSize(cache);
 
     printString("");
     printLn("Cache size in kilobytes", cacheSizeInBytes/1024);
@@ -364,6 +343,44 @@ void printDeterministicCacheInfo(const x86DeterministicCacheInfo& cache)
 
 void printLevel1CacheAndTlbFeatures(const x86L1CacheAndTlbFeatures& l1Cache)
 {
+    std::ostringstream descriptors;
+    descriptors << std::hex << std::setfill('0');
+    for (uint8_t descriptor: l1Cache.descriptors)
+    {
+        if (descriptor)
+            descriptors << std::setw(2) << (uint32_t)descriptor << " ";
+    }
+    printLn("Cache and TLB descriptors", descriptors.str());
+}
+
+std::string stringifyPageSizes(uint8_t pageSizes)
+{
+    const char *names[] = {"4K", "2M", "4M", "1G"};
+    std::string str;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        if (pageSizes & (1 << i))
+            str += (str.empty() ? "" : "/") + std::string(names[i]);
+    }
+    return str;
+}
+
+std::string stringifyTlbLevel(const x86TlbLevelInfo& tlb)
+{
+    const char *types[] = {"Null", "Data", "Instruction", "Unified", "Load", "Store"};
+    return "L" + std::to_string(tlb.level) + " " + types[(int)tlb.type] + " TLB (" +
+        stringifyPageSizes(tlb.pageSizes) + ")";
+}
+
+void printTlbLevels(const std::vector<x86TlbLevelInfo>& tlbs)
+{
+    if (tlbs.empty())
+        printString("Not reported");
+    for (const auto& tlb: tlbs)
+    {
+        printLn(stringifyTlbLevel(tlb).c_str(), std::to_string(tlb.numEntries) + " entries, " +
+            (tlb.associativity ? std::to_string(tlb.associativity) + "-way" : "fully associative"));
+    }
 }
 
 void printLevel1CacheAndTlbFeatures(const x86L1CacheAndTlbFeaturesAMD& l1Cache)
@@ -400,6 +417,14 @@ void printLevel2CacheFeatures(const x86L2CacheFeatures& l2Cache)
     printLn("Cache size in kilobytes", l2Cache.cacheSize);
 }
 
+void printLevel3CacheFeatures(const x86L3CacheFeatures& l3Cache)
+{
+    printLn("Cache line size", l3Cache.lineSize);
+    printLn("Cache lines per tag", l3Cache.linesPerTag);
+    printLn("Associativity", stringifyCacheAssociativity(l3Cache.associativity));
+    printLn("Cache size in kilobytes", l3Cache.cacheSize * 512);
+}
+
 void forEachCacheLevel(uint32_t level, const x86ProcessorInfo& info,
     std::function<void(const x86DeterministicCacheInfo& cacheInfo)> cbFn)
 {
@@ -410,74 +435,837 @@ void forEachCacheLevel(uint32_t level, const x86ProcessorInfo& info,
     }
 }
 
-int main()
+void printExtendedApicIdAMD(const x86ExtendedApicIdAMD& apicId, const x86ProcessorInfo& info)
 {
-    std::cout << "Processor information utility v. 1.0" << std::endl;
+    printLn("Extended APIC ID", apicId.extendedApicId);
+    printLn("Core ID", apicId.coreId);
+    printLn("Threads per core", apicId.threadsPerCore + 1);
+    printLn("Node ID", apicId.nodeId);
+    printLn("Nodes per processor", apicId.nodesPerProcessor + 1);
+    forEachCacheLevel(3, info,
+        [&apicId](const x86DeterministicCacheInfo& cache)
+        {   // Processors of the same slice have equal APIC ID bits above sharing width
+            uint32_t shift = 0;
+            while ((1u << shift) < cache.maxAddressableIdsForLogicalProcessors)
+                ++shift;
+            printLn("L3 slice ID", apicId.extendedApicId >> shift);
+        });
+}
 
-    waitInit();
-    const x86ProcessorInfo info = getProcessorInfo();
-    printHeading("Processor Vendor");
-    std::cout << "Vendor: " << info.vendor << std::endl;
-    std::cout << "Brandname: " << info.brand << std::endl;
+const char *stringifyCoreFrequencyMethod(x86CoreFrequencyMethod method)
+{
+    switch (method)
+    {
+    case x86CoreFrequencyMethod::DependentChain: return "dependent IMUL chain";
+    case x86CoreFrequencyMethod::AperfMperf: return "APERF/MPERF";
+    default: return "unavailable";
+    }
+}
+
+int watchCoreFrequencies(uint32_t interval)
+{   // Rows are written as they come, a structured document would never be closed
+    if (OutputFormat::Text != getOutputFormat())
+    {
+        std::cerr << "Core frequency watch supports text output only" << '\n';
+        return 2;
+    }
+    x86CoreFrequencySampler sampler;
+    const x86CoreFrequencyMethod method = sampler.getMethod();
+    if (x86CoreFrequencyMethod::Unavailable == method)
+    {
+        std::cerr << "Effective core frequency can't be measured" << '\n';
+        return 1;
+    }
+    printHeading("Effective Core Frequency (MHz)");
+    setFieldWidth(20);
+    printLn("Method", stringifyCoreFrequencyMethod(method));
+    printLn("Interval (ms)", interval);
+    printString("");
+    std::vector<std::string> names;
+    for (uint32_t processor: getLogicalProcessors())
+        names.push_back("CPU" + std::to_string(processor));
+    std::vector<std::pair<const char *, int>> columns = {{"Time (s)", 10}};
+    for (const auto& name: names)
+        columns.push_back({name.c_str(), 7});
+    printTableHeader("Frequencies", columns);
+    const auto begin = std::chrono::steady_clock::now();
+    while (true)
+    {
+        const std::vector<x86CoreFrequency> frequencies = sampler.sample(interval * 1000000ull);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        std::vector<std::pair<std::string, int>> cells = {{fixedString(elapsed.count(), 1), 10}};
+        for (const auto& it: frequencies)
+            cells.push_back({std::to_string(it.frequency/1000000ull), 7});
+        printTableRow(cells);
+        flushOutput();
+    }
+    return 0;
+}
+
+int runMemoryLatency()
+{
+    const x86ProcessorInfo& info = queryProcessorInfo(x86SectionVendor | x86SectionCaches);
+    std::vector<x86CacheLevelInfo> levels;
+    for (uint32_t level = 1; level <= 4; ++level)
+    {
+        x86CacheLevelInfo cache;
+        if (getDataCacheLevel(info, level, cache))
+            levels.push_back(cache);
+    }
+    constexpr uint64_t minSize = 4 * 1024;
+    constexpr uint64_t maxLimit = 1024 * 1024 * 1024;
+    // Sweep up to several times the last level cache
+    const uint64_t maxSize = levels.empty() ? 64 * 1024 * 1024 :
+        std::min<uint64_t>(levels.back().size * 4ull, maxLimit);
+    const uint32_t lineSize = levels.empty() ? 64 : levels.front().lineSize;
+    const std::vector<x86LatencySample> samples = measureMemoryLatency(minSize, maxSize, lineSize);
+    if (samples.empty())
+    {
+        std::cerr << "Memory latency can't be measured" << '\n';
+        return 1;
+    }
+    printHeading("Memory Latency");
+    printTableHeader("Samples", {{"Working set (KiB)", 20}, {"ns/load", 12}, {"cycles/load", 0}});
+    for (const auto& sample: samples)
+    {
+        printTableRow({{std::to_string(sample.workingSetSize/1024), 20},
+            {fixedString(sample.nanoseconds, 2), 12}, {fixedString(sample.cycles, 2), 0}});
+    }
+    printHeading("Memory Hierarchy");
+    printTableHeader("Levels", {{"Level", 10}, {"Measured (KiB)", 20}, {"CPUID (KiB)", 16},
+        {"ns/load", 12}, {"cycles/load", 0}});
+    const std::vector<x86LatencyPlateau> plateaus = detectLatencyPlateaus(samples);
+    // Level belongs to the last plateau starting below its size, which either contains
+    // the size or ends just before the step; merged levels share a plateau
+    std::vector<std::string> names(plateaus.size()), sizes(plateaus.size());
+    for (const auto& cache: levels)
+    {
+        size_t match = plateaus.size();
+        for (size_t i = 0; i < plateaus.size(); ++i)
+        {
+            if (plateaus[i].minSize < cache.size)
+                match = i;
+        }
+        if (match == plateaus.size())
+            continue;
+        names[match] += (names[match].empty() ? "L" : "/L") + std::to_string(cache.level);
+        sizes[match] += (sizes[match].empty() ? "" : "/") + std::to_string(cache.size/1024);
+    }
+    for (size_t i = 0; i < plateaus.size(); ++i)
+    {   // Unmatched plateau past the last level cache is memory
+        const x86LatencyPlateau& plateau = plateaus[i];
+        const bool isLast = (i + 1 == plateaus.size());
+        const std::string name = !names[i].empty() ? names[i] : (isLast ? "DRAM" : "Unknown");
+        const std::string measured = !isLast ?
+            "<= " + std::to_string(plateau.maxSize/1024) : ">= " + std::to_string(plateau.minSize/1024);
+        printTableRow({{name, 10}, {measured, 20}, {!sizes[i].empty() ? sizes[i] : "-", 16},
+            {fixedString(plateau.nanoseconds, 2), 12}, {fixedString(plateau.cycles, 2), 0}});
+    }
+    return 0;
+}
+
+int runMemoryBandwidth()
+{
+    const char *levelNames[] = {"L1", "L2", "L3", "DRAM"};
+    const uint32_t numKernels = (uint32_t)x86BandwidthKernel::Count;
+    const std::vector<uint32_t> threadCounts = getBandwidthThreadCounts();
+    printHeading("Memory Bandwidth Kernels");
+    setFieldWidth(20);
+    for (uint32_t k = 0; k < numKernels; ++k)
+        printLn(getBandwidthKernelName((x86BandwidthKernel)k), getBandwidthKernelVariant((x86BandwidthKernel)k));
+    const uint32_t numLevels = (uint32_t)x86BandwidthLevel::Count;
+    std::vector<std::vector<uint32_t>> saturation(numKernels, std::vector<uint32_t>(numLevels));
+    for (uint32_t level = 0; level < numLevels; ++level)
+    {
+        printHeading((std::string(levelNames[level]) + " Bandwidth (GB/s)").c_str());
+        std::vector<std::pair<const char *, int>> columns = {{"Threads", 10}, {"Set/thread (KiB)", 18}};
+        for (uint32_t k = 0; k < numKernels; ++k)
+            columns.push_back({getBandwidthKernelName((x86BandwidthKernel)k), 10});
+        printTableHeader("Bandwidth", columns);
+        std::vector<std::vector<x86BandwidthResult>> results(numKernels);
+        for (uint32_t numThreads: threadCounts)
+        {   // Progress of long measurement goes aside of the report
+            std::cerr << "Measuring " << levelNames[level] << " bandwidth with " << numThreads << " threads" << '\n';
+            std::vector<std::pair<std::string, int>> cells = {{std::to_string(numThreads), 10}};
+            for (uint32_t k = 0; k < numKernels; ++k)
+            {
+                const x86BandwidthResult result = measureMemoryBandwidth((x86BandwidthKernel)k,
+                    (x86BandwidthLevel)level, numThreads);
+                if (!k)
+                    cells.push_back({std::to_string(result.workingSetSize/1024), 18});
+                cells.push_back({fixedString(result.bandwidth, 1), 10});
+                results[k].push_back(result);
+            }
+            printTableRow(cells);
+        }
+        for (uint32_t k = 0; k < numKernels; ++k)
+            saturation[k][level] = getBandwidthSaturationPoint(results[k]);
+    }
+    printHeading("Bandwidth Saturation (threads)");
+    std::vector<std::pair<const char *, int>> columns = {{"Kernel", 10}};
+    for (uint32_t level = 0; level < numLevels; ++level)
+        columns.push_back({levelNames[level], 8});
+    printTableHeader("Saturation", columns);
+    for (uint32_t k = 0; k < numKernels; ++k)
+    {
+        std::vector<std::pair<std::string, int>> cells = {{getBandwidthKernelName((x86BandwidthKernel)k), 10}};
+        for (uint32_t level = 0; level < numLevels; ++level)
+            cells.push_back({std::to_string(saturation[k][level]), 8});
+        printTableRow(cells);
+    }
+    return 0;
+}
+
+static std::string thresholdString(uint64_t size)
+{
+    return (size == std::numeric_limits<uint64_t>::max()) ? std::string("Never") : std::to_string(size);
+}
+
+void printCopyPlan(const x86CopyPlan& plan)
+{
+    printLn("Source", stringifyCopyPlanSource(plan.source));
+    printLn("Vector variant", plan.vectorVariant);
+    printLn("REP MOVSB from (bytes)", (plan.repMovsbThreshold < plan.nonTemporalThreshold) ?
+        thresholdString(plan.repMovsbThreshold) : std::string("Never"));
+    printLn("REP STOSB from (bytes)", (plan.repStosbThreshold < plan.nonTemporalThreshold) ?
+        thresholdString(plan.repStosbThreshold) : std::string("Never"));
+    printLn("Non-temporal from (bytes)", thresholdString(plan.nonTemporalThreshold));
+}
+
+int runCopyCalibration()
+{
+    printHeading("Copy Plan Defaults");
+    setFieldWidth(30);
+    printCopyPlan(getCopyPlan());
+    std::cerr << "Calibrating copy thresholds" << '\n'; // Takes a while
+    printHeading("Calibrated Copy Plan");
+    const x86CopyPlan& plan = calibrateCopyPlan();
+    printCopyPlan(plan);
+    printString("");
+    printTableHeader("Strategies", {{"Size (bytes)", 16}, {"Copy", 16}, {"Fill", 0}});
+    for (uint64_t size = 64; size <= 256ull * 1024 * 1024; size *= 4)
+    {
+        printTableRow({{std::to_string(size), 16},
+            {stringifyCopyStrategy(getCopyStrategy(plan, (size_t)size)), 16},
+            {stringifyCopyStrategy(getCopyStrategy(plan, (size_t)size, true)), 0}});
+    }
+    return 0;
+}
 
-    printHeading("Processor Signature");
+int runInstructionTimings()
+{
+    const x86InstructionTimings timings = measureInstructionTimings();
+    if (!timings.tscFrequency)
+    {
+        std::cerr << "Time stamp counter frequency is unknown" << '\n';
+        return 1;
+    }
+    if (!timings.coreFrequency)
+    {
+        std::cerr << "Instruction timings can't be measured on a pinned thread" << '\n';
+        return 1;
+    }
+    printHeading("Instruction Timings");
     setFieldWidth(25);
-    printProcessorSignature(info.signature);
+    printLn("TSC frequency (MHz)", timings.tscFrequency/1000000ull);
+    printLn("Core frequency (MHz)", timings.coreFrequency/1000000ull);
+    printString("");
+    printTableHeader("Instructions", {{"Instruction", 34}, {"Feature", 14}, {"Latency", 10}, {"Throughput", 0}});
+    for (const auto& timing: timings.timings)
+    {
+        printTableRow({{timing.instruction, 34}, {*timing.feature ? timing.feature : "x86-64", 14},
+            {timing.measured ? fixedString(timing.latency, 2) : "-", 10},
+            {timing.measured ? (timing.throughputBound ? "<=" : "") + fixedString(timing.throughput, 2) : "-", 0}});
+    }
+    return 0;
+}
 
-    printHeading("Processor Frequency");
-    setFieldWidth(35);
-    printProcessorFrequency(info.frequency);
+int runCoreToCoreLatency(bool csv)
+{
+    const x86CoreToCoreLatency latency = measureCoreToCoreLatency();
+    const size_t count = latency.processors.size();
+    if (csv)
+    {   // Plain matrix for plotting tools
+        output << "cpu";
+        for (uint32_t processor: latency.processors)
+            output << "," << processor;
+        output << '\n' << std::fixed << std::setprecision(1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            output << latency.processors[i];
+            for (size_t j = 0; j < count; ++j)
+            {
+                const double ns = latency.nanoseconds[i * count + j];
+                output << ",";
+                if (!std::isnan(ns))
+                    output << ns;
+            }
+            output << '\n';
+        }
+        return 0;
+    }
+    printHeading("Core-to-Core Round Trip Latency (ns)");
+    std::vector<std::string> names;
+    for (uint32_t processor: latency.processors)
+        names.push_back(std::to_string(processor));
+    std::vector<std::pair<const char *, int>> columns = {{"CPU", 6}};
+    for (const auto& name: names)
+        columns.push_back({name.c_str(), 6});
+    printTableHeader("Matrix", columns);
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::vector<std::pair<std::string, int>> cells = {{names[i], 6}};
+        for (size_t j = 0; j < count; ++j)
+        {
+            const double ns = latency.nanoseconds[i * count + j];
+            cells.push_back({std::isnan(ns) ? std::string("-") : fixedString(ns, 0), 6});
+        }
+        printTableRow(cells);
+    }
+    // Summarize pairs by the closest topology domain they share,
+    // cores of a die are split by L3 domain when its sharing is known
+    const char *relations[] = {"SMT siblings", "Same L3", "Cross L3", "Same die", "Same package", "Cross package"};
+    constexpr uint32_t numRelations = sizeof(relations)/sizeof(relations[0]);
+    double sums[numRelations] = {}, mins[numRelations], maxs[numRelations] = {};
+    uint32_t counts[numRelations] = {};
+    std::fill(std::begin(mins), std::end(mins), std::numeric_limits<double>::max());
+    const x86ProcessorTopology topology = getProcessorTopology();
+    x86CacheLevelInfo l3;
+    const bool l3Known = getDataCacheLevel(queryProcessorInfo(x86SectionVendor | x86SectionCaches), 3, l3) &&
+        l3.sharingLogicalProcessors;
+    uint32_t l3Shift = 0; // Processors sharing L3 have equal APIC ID bits above the shift
+    while (l3Known && ((1u << l3Shift) < l3.sharingLogicalProcessors))
+        ++l3Shift;
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (size_t j = i + 1; j < count; ++j)
+        {
+            const double ns = latency.nanoseconds[i * count + j];
+            if (std::isnan(ns))
+                continue;
+            const x86LogicalProcessor& a = topology.processors[latency.processors[i]];
+            const x86LogicalProcessor& b = topology.processors[latency.processors[j]];
+            const bool sameL3 = (a.x2ApicId >> l3Shift) == (b.x2ApicId >> l3Shift);
+            const uint32_t relation = (a.packageId != b.packageId) ? 5 : (a.dieId != b.dieId) ? 4 :
+                (a.coreId == b.coreId) ? 0 : !l3Known ? 3 : sameL3 ? 1 : 2;
+            sums[relation] += ns;
+            mins[relation] = std::min(mins[relation], ns);
+            maxs[relation] = std::max(maxs[relation], ns);
+            ++counts[relation];
+        }
+    }
+    printHeading("Core-to-Core Latency Summary (ns)");
+    printTableHeader("Relations", {{"Relation", 16}, {"Pairs", 8}, {"Min", 8}, {"Avg", 8}, {"Max", 0}});
+    for (uint32_t r = 0; r < numRelations; ++r)
+    {
+        if (!counts[r])
+            continue;
+        printTableRow({{relations[r], 16}, {std::to_string(counts[r]), 8}, {fixedString(mins[r], 0), 8},
+            {fixedString(sums[r]/counts[r], 0), 8}, {fixedString(maxs[r], 0), 0}});
+    }
+    return 0;
+}
 
-    printHeading("Processor Misc Information");
-    setFieldWidth(45);
-    printProcessorMiscInfo(info.misc, (x86VendorId::Intel == info.vendorId));
+int runTlbLatency()
+{
+    const x86ProcessorInfo& info = queryProcessorInfo(x86SectionVendor | x86SectionCaches);
+    const std::vector<x86TlbLevelInfo> tlbs = getTlbLevels(info);
+    printHeading("TLB Reach");
+    setFieldWidth(35);
+    if (tlbs.empty())
+        printString("Not reported");
+    for (const auto& tlb: tlbs)
+    {   // Reach of the smallest supported page
+        if (x86TlbType::Instruction == tlb.type)
+            continue;
+        const uint64_t pageSize = (tlb.pageSizes & x86PageSize4K) ? 4096ull :
+            (tlb.pageSizes & x86PageSize2M) ? 2097152ull : (tlb.pageSizes & x86PageSize4M) ? 4194304ull : 1ull << 30;
+        printLn(stringifyTlbLevel(tlb).c_str(), std::to_string(tlb.numEntries * pageSize/1024) + " KiB");
+    }
+    constexpr uint64_t minPages = 16;
+    constexpr uint64_t maxPages = 64 * 1024;
+    const std::vector<x86TlbLatencySample> small = measureTlbLatency(minPages, maxPages, x86PageBacking::Small);
+    const std::vector<x86TlbLatencySample> huge = measureTlbLatency(minPages, maxPages, x86PageBacking::Huge);
+    if (small.empty())
+    {
+        std::cerr << "TLB latency can't be measured" << '\n';
+        return 1;
+    }
+    printHeading("TLB Latency (one line per 4K page)");
+    printTableHeader("Samples", {{"Pages", 10}, {"Range (KiB)", 14}, {"4K ns", 12}, {"4K cycles", 14},
+        {"THP ns", 12}, {"THP cycles", 0}});
+    for (size_t i = 0; i < small.size(); ++i)
+    {
+        const bool isHuge = (i < huge.size());
+        printTableRow({{std::to_string(small[i].numPages), 10}, {std::to_string(small[i].numPages * 4), 14},
+            {fixedString(small[i].nanoseconds, 2), 12}, {fixedString(small[i].cycles, 2), 14},
+            {isHuge ? fixedString(huge[i].nanoseconds, 2) : "-", 12},
+            {isHuge ? fixedString(huge[i].cycles, 2) : "-", 0}});
+    }
+    return 0;
+}
 
-    printHeading("Processor Features");
+int printCacheAdvice(uint32_t elementSize, uint32_t numThreads)
+{
+    const x86CacheAdvice advice = getCacheAdvice(elementSize, numThreads);
+    printHeading("Cache Blocking Advice");
     setFieldWidth(35);
-    const bool isAMD = (x86VendorId::AMD == info.vendorId);
-    if (isAMD)
-        printProcessorFeatures(info.featuresAMD);
-    else
-        printProcessorFeatures(info.features);
+    printLn("Element size in bytes", advice.elementSize);
+    printLn("Threads", advice.numThreads);
+    printLn("Cache line size", advice.lineSize);
+    printLn("Data TLB entries", advice.dataTlbEntries);
+    printLn("Partition fan-out", advice.partitionFanOut);
+    printLn("Radix bits", advice.radixBits);
+    printString("");
+    printTableHeader("Blocks", {{"Level", 8}, {"Cache (KiB)", 18}, {"Threads/cache", 18}, {"Block (KiB)", 18},
+        {"Elements", 14}, {"Tile", 0}});
+    for (const auto& block: advice.blocks)
+    {
+        printTableRow({{"L" + std::to_string(block.level), 8}, {std::to_string(block.cacheSize/1024), 18},
+            {std::to_string(block.threadsPerInstance), 18}, {std::to_string(block.blockSize/1024), 18},
+            {std::to_string(block.numElements), 14},
+            {std::to_string(block.tileSize) + "x" + std::to_string(block.tileSize), 0}});
+    }
+    return 0;
+}
+
+int scanCpuIdDumps(const char *directory)
+{
+    const std::vector<x86ProcessorDump> dumps = decodeCpuIdDumps(directory);
+    printHeading("CPUID Dumps");
+    printTableHeader("Dumps", {{"Dump", 40}, {"Vendor", 14}, {"Family", 8}, {"Model", 8}, {"Threads", 9},
+        {"Brand", 0}});
+    uint32_t numInvalid = 0;
+    for (const auto& dump: dumps)
+    {
+        if (!dump.valid)
+        {
+            printTableRow({{dump.path, 40}, {"Invalid dump", 14}, {"-", 8}, {"-", 8}, {"-", 9}, {"-", 0}});
+            ++numInvalid;
+            continue;
+        }
+        const x86ProcessorSignature& signature = dump.info.signature;
+        printTableRow({{dump.path, 40}, {dump.info.vendor, 14}, {hexString(getDisplayFamily(signature)), 8},
+            {hexString(getDisplayModel(signature)), 8}, {std::to_string(dump.physicalThreadCount), 9},
+            {dump.info.brand, 0}});
+    }
+    return numInvalid ? 1 : 0;
+}
+
+static bool readFeatureSet(const char *path, x86FeatureSet& features)
+{   // No path stands for this host
+    if (!path)
+    {
+        features = getFeatureSet(queryProcessorInfo(x86SectionFeatures));
+        return true;
+    }
+    CpuIdDump dump;
+    if (!dump.open(path))
+    {
+        std::cerr << "Can't open CPUID dump " << path << '\n';
+        return false;
+    }
+    CpuIdReplayScope scope(dump);
+    features = getFeatureSet(queryProcessorInfo(x86SectionFeatures));
+    return true;
+}
 
-    printHeading("Extended Processor Features");
-    setFieldWidth(50);
-    printExtendedProcessorFeatures(info.extendedFeatures);
+int compareProcessorFeatures(const char *first, const char *second)
+{
+    x86FeatureSet firstFeatures, secondFeatures;
+    if (!readFeatureSet(first, firstFeatures) || !readFeatureSet(second, secondFeatures))
+        return 1;
+    const x86FeatureComparison comparison = compareFeatureSets(firstFeatures, secondFeatures);
+    printHeading("Feature Comparison");
+    setFieldWidth(30);
+    printLn("First: ", std::string(first));
+    printLn("Second: ", std::string(second ? second : "this host"));
+    printLn("Common features", comparison.common.count());
+    printLn("Only on first", comparison.onlyFirst.count());
+    printLn("Only on second", comparison.onlySecond.count());
+    printLn("Second runs builds of first", Boolean{comparison.onlyFirst.none()});
+    printLn("First runs builds of second", Boolean{comparison.onlySecond.none()});
+    const x86FeatureSet difference = comparison.onlyFirst | comparison.onlySecond;
+    if (difference.none())
+        return 0;
+    printString("");
+    printTableHeader("Differences", {{"Feature", 22}, {"First", 8}, {"Second", 8}, {"Description", 0}});
+    for (uint32_t i = 0; i < getFeatureCount(); ++i)
+    {
+        if (!difference.test(i))
+            continue;
+        const x86FeatureInfo& feature = getFeatureInfo(i);
+        printTableRow({{feature.name, 22}, {firstFeatures.test(i) ? "Yes" : "No", 8},
+            {secondFeatures.test(i) ? "Yes" : "No", 8}, {feature.description, 0}});
+    }
+    return 0;
+}
 
-    printHeading("Thermal Power Management Features");
-    printThermalPowerManagementFeatures(info.tpmFeatures, isAMD);
+static std::string joinFeatureNames(const x86FeatureSet& features)
+{
+    std::string names;
+    for (uint32_t i = 0; i < getFeatureCount(); ++i)
+    {
+        if (features.test(i))
+            names += (names.empty() ? "" : " ") + std::string(getFeatureInfo(i).name);
+    }
+    return names;
+}
 
-    printHeading("Advanced Power Management Features");
-    printAdvancedPowerManagementFeatures(info.apmFeatures, isAMD);
+int printIsaBaseline(const char *directory)
+{
+    const x86IsaBaseline baseline = getIsaBaseline(decodeCpuIdDumps(directory));
+    printHeading("ISA Baseline");
+    setFieldWidth(30);
+    printLn("Hosts", baseline.numHosts);
+    printLn("Invalid dumps", baseline.numInvalid);
+    if (!baseline.numHosts)
+        return 1;
+    printLn("Common features", baseline.common.count());
+    printLn("Microarchitecture level", stringifyIsaLevel(baseline.level));
+    printLn("Compiler flags", baseline.compilerFlags);
+    if (baseline.blockers.empty())
+        return 0;
+    const x86IsaLevel next = (x86IsaLevel)((uint8_t)baseline.level + 1);
+    printString("");
+    printLn("Next level", stringifyIsaLevel(next));
+    printTableHeader("Blocking hosts", {{"Dump", 40}, {"Missing", 0}});
+    for (const auto& blocker: baseline.blockers)
+        printTableRow({{blocker.path, 40}, {joinFeatureNames(blocker.missing), 0}});
+    return 0;
+}
 
-    printHeading("L1 Cache Identifiers");
-    setFieldWidth(35);
-    if (isAMD)
-        printLevel1CacheAndTlbFeatures(info.l1CacheAMD);
-    else
-        printLevel1CacheAndTlbFeatures(info.l1Cache);
-    forEachCacheLevel(1, info,
-        [](const x86DeterministicCacheInfo& cache)
+/* Sections of the report, which can be selected with --sections. */
+
+enum ReportSection : uint32_t
+{
+    ReportVendor = 0x1,
+    ReportSignature = 0x2,
+    ReportFrequency = 0x4,
+    ReportMisc = 0x8,
+    ReportTopology = 0x10,
+    ReportFeatures = 0x20,
+    ReportPower = 0x40,
+    ReportCaches = 0x80,
+    ReportTlb = 0x100,
+    ReportXsave = 0x200,
+    ReportAll = 0x3FF
+};
+
+struct ReportSectionName
+{
+    const char *name;
+    ReportSection section;
+    uint32_t infoSections;      // Processor information required by the section
+};
+
+static const ReportSectionName reportSections[] = {
+    {"vendor", ReportVendor, x86SectionVendor | x86SectionBrand},
+    {"signature", ReportSignature, x86SectionFeatures},
+    {"frequency", ReportFrequency, x86SectionFeatures | x86SectionFrequency},
+    {"misc", ReportMisc, x86SectionFeatures},
+    {"topology", ReportTopology, x86SectionCaches},
+    {"features", ReportFeatures, x86SectionFeatures},
+    {"power", ReportPower, x86SectionFeatures},
+    {"caches", ReportCaches, x86SectionCaches},
+    {"tlb", ReportTlb, x86SectionCaches},
+    {"xsave", ReportXsave, x86SectionFeatures}
+};
+
+static uint32_t parseReportSections(const char *list)
+{   // Comma separated names, unknown names are ignored
+    uint32_t sections = 0;
+    std::string names(list);
+    size_t begin = 0;
+    while (begin <= names.size())
+    {
+        size_t end = names.find(',', begin);
+        if (std::string::npos == end)
+            end = names.size();
+        const std::string name = names.substr(begin, end - begin);
+        for (const auto& it: reportSections)
         {
-            printString("");
-            printDeterministicCacheInfo(cache);
-        });
+            if (name == it.name)
+                sections |= it.section;
+        }
+        begin = end + 1;
+    }
+    return sections;
+}
 
-    printHeading("L2 Cache Identifiers");
-    forEachCacheLevel(2, info,
-        [](const x86DeterministicCacheInfo& cache)
+static bool parseOutputFormat(const char *name)
+{
+    const struct { const char *name; OutputFormat format; } formats[] = {
+        {"text", OutputFormat::Text}, {"json", OutputFormat::Json},
+        {"csv", OutputFormat::Csv}, {"prometheus", OutputFormat::Prometheus}
+    };
+    for (const auto& it: formats)
+    {
+        if (!strcmp(name, it.name))
         {
-            printDeterministicCacheInfo(cache);
-            printString("");
-        });
-    printLevel2CacheFeatures(info.l2Cache);
+            setOutputFormat(it.format);
+            return true;
+        }
+    }
+    return false;
+}
 
-    printHeading("L3 Cache Identifiers");
-    forEachCacheLevel(3, info,
-        [](const x86DeterministicCacheInfo& cache)
+int run(int argc, char *argv[])
+{
+    CpuIdDump replayDump;
+    uint32_t sections = ReportAll;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--format") && (i + 1 < argc))
         {
-            printDeterministicCacheInfo(cache);
-        });
+            if (!parseOutputFormat(argv[++i]))
+            {
+                std::cerr << "Unknown output format " << argv[i] << '\n';
+                return 1;
+            }
+            continue;
+        }
+        if (!strcmp(argv[i], "--sections") && (i + 1 < argc))
+        {
+            sections = parseReportSections(argv[++i]);
+            continue;
+        }
+        if (!strcmp(argv[i], "--dump") && (i + 1 < argc))
+        {
+            if (!writeCpuIdDump(argv[i + 1]))
+            {
+                std::cerr << "Can't write CPUID dump " << argv[i + 1] << '\n';
+                return 1;
+            }
+            return 0;
+        }
+        if (!strcmp(argv[i], "--replay") && (i + 1 < argc))
+        {   // Decode recorded processor, measurements are skipped
+            if (!replayDump.open(argv[++i]))
+            {
+                std::cerr << "Can't open CPUID dump " << argv[i] << '\n';
+                return 1;
+            }
+            setCpuIdSource(&replayDump);
+            continue;
+        }
+        if (!strcmp(argv[i], "--has") && (i + 1 < argc))
+        {   // Answer is the exit code, nothing is printed or measured
+            const x86FeatureQueryResult result = queryProcessorFeatures(argv[i + 1]);
+            if (x86FeatureQueryResult::Unknown == result)
+                std::cerr << "Unknown feature name in " << argv[i + 1] << '\n';
+            return (int)result;
+        }
+        if (!strcmp(argv[i], "--compare") && (i + 1 < argc))
+        {   // Dump against another dump or this host
+            const char *second = ((i + 2 < argc) && strncmp(argv[i + 2], "--", 2)) ? argv[i + 2] : nullptr;
+            return compareProcessorFeatures(argv[i + 1], second);
+        }
+        if (!strcmp(argv[i], "--baseline") && (i + 1 < argc))
+            return printIsaBaseline(argv[i + 1]);
+        if (!strcmp(argv[i], "--scan") && (i + 1 < argc))
+            return scanCpuIdDumps(argv[i + 1]);
+        if (!strcmp(argv[i], "--watch"))
+        {   // Optional sampling interval in milliseconds
+            uint32_t interval = 1000;
+            if ((i + 1 < argc) && isdigit(argv[i + 1][0]))
+                interval = std::max(atoi(argv[++i]), 1);
+            waitInit();
+            return watchCoreFrequencies(interval);
+        }
+        if (!strcmp(argv[i], "--bandwidth"))
+            return runMemoryBandwidth();
+        if (!strcmp(argv[i], "--instructions"))
+        {
+            waitInit();
+            return runInstructionTimings();
+        }
+        if (!strcmp(argv[i], "--memcpy"))
+        {
+            waitInit();
+            return runCopyCalibration();
+        }
+        if (!strcmp(argv[i], "--blocking"))
+        {   // Optional element size in bytes and number of threads
+            uint32_t elementSize = 8, numThreads = 1;
+            if ((i + 1 < argc) && isdigit(argv[i + 1][0]))
+                elementSize = std::max(atoi(argv[++i]), 1);
+            if ((i + 1 < argc) && isdigit(argv[i + 1][0]))
+                numThreads = std::max(atoi(argv[++i]), 1);
+            return printCacheAdvice(elementSize, numThreads);
+        }
+        if (!strcmp(argv[i], "--tlb"))
+        {
+            waitInit();
+            return runTlbLatency();
+        }
+        if (!strcmp(argv[i], "--core-latency"))
+        {   // Optional CSV output for plotting
+            const bool csv = (i + 1 < argc) && !strcmp(argv[i + 1], "csv");
+            if (csv && (OutputFormat::Text != getOutputFormat()))
+            {
+                std::cerr << "CSV latency matrix can't be combined with --format" << '\n';
+                return 2;
+            }
+            return runCoreToCoreLatency(csv);
+        }
+        if (!strcmp(argv[i], "--latency"))
+        {
+            waitInit();
+            return runMemoryLatency();
+        }
+    }
+
+    const bool isText = (OutputFormat::Text == getOutputFormat());
+    if (isText)
+        output << "Processor information utility v. 1.0" << '\n';
+
+    waitInit();
+    // Replayed processor is decoded only, it can't be measured or run on
+    const bool replay = (getCpuIdSource() != nullptr);
+    uint32_t infoSections = 0;
+    for (const auto& it: reportSections)
+    {   // Don't pay for frequency if it's not requested
+        if (sections & it.section)
+            infoSections |= it.infoSections;
+    }
+    const x86ProcessorInfo& info = queryProcessorInfo(infoSections);
+    const bool isAMD = (x86VendorId::AMD == info.vendorId);
+    const bool isHygon = (x86VendorId::Hygon == info.vendorId);
+    if (sections & ReportVendor)
+    {
+        printHeading("Processor Vendor");
+        setFieldWidth(0);
+        printLn("Vendor: ", info.vendor);
+        printLn("Brandname: ", info.brand);
+    }
+    if (sections & ReportSignature)
+    {
+        printHeading("Processor Signature");
+        setFieldWidth(25);
+        printProcessorSignature(info.signature);
+        printString("");
+        printMicroarchitecture(info);
+    }
+    if (sections & ReportFrequency)
+    {
+        printHeading("Processor Frequency");
+        setFieldWidth(35);
+        printProcessorFrequency(info.frequency);
+    }
+    if (sections & ReportMisc)
+    {
+        printHeading("Processor Misc Information");
+        setFieldWidth(45);
+        printProcessorMiscInfo(info.misc, (x86VendorId::Intel == info.vendorId));
+        if (!replay)
+        {
+            printLn("Cache line size", getCacheLineSize());
+            printLn("False sharing size", getFalseSharingSize());
+        }
+    }
+    if ((sections & ReportTopology) && !replay)
+    {
+        printHeading("Processor Topology");
+        setFieldWidth(20);
+        const x86ProcessorTopology topology = getProcessorTopology();
+        printProcessorTopology(topology);
+
+        printHeading("Core Types");
+        printCoreTypes(getCoreTypes(topology));
+
+        printHeading("Affinity Plans");
+        printAffinityPlans();
+    }
+    if (sections & ReportFeatures)
+    {
+        printHeading("Processor Features");
+        setFieldWidth(35);
+        const x86FeatureSet features = getFeatureSet(info);
+        printProcessorFeatures(features, isAMD ? CPUID_EXTENDED_ID + 0x1 : 0x1);
+
+        printHeading("Extended Processor Features");
+        setFieldWidth(50);
+        printProcessorFeatures(features, 0x7);
+        if (!replay)
+        {
+            printString("");
+            printLn("OS enabled state components (XCR0)", hexString(getEnabledStateComponents()));
+            const x86FeatureMask& usable = getProcessorFeatureMask();
+            printLn("AVX usable", booleanString(usable.features.advancedVectorExtensions));
+            printLn("AVX512 usable", booleanString(usable.extendedFeatures.avx512Foundation));
+            printLn("AMX usable", booleanString(usable.extendedFeatures.amxTile));
+            printLn("Highest dispatch tier", stringifyDispatchTier(getProcessorDispatchTier()));
+        }
+    }
+    if ((sections & ReportXsave) && info.features.xsaveRestore)
+    {
+        printHeading("Extended State (XSAVE)");
+        setFieldWidth(35);
+        printExtendedState(info, getEnabledStateComponents());
+    }
+    if (sections & ReportPower)
+    {
+        printHeading("Thermal Power Management Features");
+        setFieldWidth(50);
+        printThermalPowerManagementFeatures(info.tpmFeatures, isAMD);
+
+        printHeading("Advanced Power Management Features");
+        printAdvancedPowerManagementFeatures(info.apmFeatures, isAMD);
+    }
+    if (sections & ReportCaches)
+    {
+        printHeading("L1 Cache Identifiers");
+        setFieldWidth(35);
+        if (isAMD)
+            printLevel1CacheAndTlbFeatures(info.l1CacheAMD);
+        else
+            printLevel1CacheAndTlbFeatures(info.l1Cache);
+        forEachCacheLevel(1, info,
+            [](const x86DeterministicCacheInfo& cache)
+            {
+                printString("");
+                printDeterministicCacheInfo(cache);
+            });
+
+        printHeading("L2 Cache Identifiers");
+        forEachCacheLevel(2, info,
+            [](const x86DeterministicCacheInfo& cache)
+            {
+                printDeterministicCacheInfo(cache);
+                printString("");
+            });
+        printLevel2CacheFeatures(info.l2Cache);
 
+        printHeading("L3 Cache Identifiers");
+        forEachCacheLevel(3, info,
+            [](const x86DeterministicCacheInfo& cache)
+            {
+                printDeterministicCacheInfo(cache);
+                printString("");
+            });
+        if (isAMD || isHygon)
+        {
+            printLevel3CacheFeatures(info.l3Cache);
+            if (info.extendedApicIdAMD.ebx || info.extendedApicIdAMD.ecx)
+            {
+                printHeading("Extended APIC ID");
+                printExtendedApicIdAMD(info.extendedApicIdAMD, info);
+            }
+        }
+    }
+    if (sections & ReportTlb)
+    {
+        printHeading("TLB Identifiers");
+        setFieldWidth(35);
+        printTlbLevels(getTlbLevels(info));
+    }
     return 0;
 }
+
+int main(int argc, char *argv[])
+{   // Output is accumulated and written at once
+    const int result = run(argc, argv);
+    flushOutput();
+    return result;
+}
@@ -0,0 +1,302 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "memoryBandwidth.h"
+#include "cpuDispatchx86.h"
+#include "cpuTopologyx86.h"
+#include "threadAffinity.h"
+
+#define ALIGNMENT           64
+#define BLOCK_SIZE          512     // Array sizes are multiple of unrolled loop step
+#define TARGET_BYTES        (256ull * 1024 * 1024)
+#define MAX_WORKING_SET     (1024ull * 1024 * 1024)
+
+typedef double (*BandwidthKernelFn)(double *a, const double *b, const double *c, size_t count);
+
+static const char *kernelNames[] = {
+    "Read", "Write", "Copy", "Triad", "Write NT", "Copy NT", "Triad NT"
+};
+
+// Bytes moved per element of array
+static const uint32_t kernelArrays[] = {1, 1, 2, 3, 1, 2, 3};
+
+static double readGeneric(double *, const double *b, const double *, size_t count)
+{
+    double sum = 0.;
+    for (size_t i = 0; i < count; ++i)
+        sum += b[i];
+    return sum;
+}
+
+static double writeGeneric(double *a, const double *, const double *, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        a[i] = 1.;
+    return 0.;
+}
+
+static double copyGeneric(double *a, const double *b, const double *, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        a[i] = b[i];
+    return 0.;
+}
+
+static double triadGeneric(double *a, const double *b, const double *c, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        a[i] = b[i] + 3. * c[i];
+    return 0.;
+}
+
+/* Defines kernels for vector ISA. Loops are unrolled by four vectors,
+   read uses independent accumulators to hide latency of addition. */
+
+#define DEFINE_BANDWIDTH_KERNELS(Isa, isa, vec, width, load, store, stream, add, mul, set1, fence)\
+X86_TARGET(isa) static double read##Isa(double *, const double *b, const double *, size_t count)\
+{\
+    vec sum0 = set1(0.), sum1 = set1(0.), sum2 = set1(0.), sum3 = set1(0.);\
+    for (size_t i = 0; i < count; i += width * 4)\
+    {\
+        sum0 = add(sum0, load(b + i));\
+        sum1 = add(sum1, load(b + i + width));\
+        sum2 = add(sum2, load(b + i + width * 2));\
+        sum3 = add(sum3, load(b + i + width * 3));\
+    }\
+    alignas(64) double sum[width];\
+    store(sum, add(add(sum0, sum1), add(sum2, sum3)));\
+    return sum[0];\
+}\
+X86_TARGET(isa) static double write##Isa(double *a, const double *, const double *, size_t count)\
+{\
+    const vec one = set1(1.);\
+    for (size_t i = 0; i < count; i += width * 4)\
+    {\
+        store(a + i, one);\
+        store(a + i + width, one);\
+        store(a + i + width * 2, one);\
+        store(a + i + width * 3, one);\
+    }\
+    return 0.;\
+}\
+X86_TARGET(isa) static double copy##Isa(double *a, const double *b, const double *, size_t count)\
+{\
+    for (size_t i = 0; i < count; i += width * 4)\
+    {\
+        store(a + i, load(b + i));\
+        store(a + i + width, load(b + i + width));\
+        store(a + i + width * 2, load(b + i + width * 2));\
+        store(a + i + width * 3, load(b + i + width * 3));\
+    }\
+    return 0.;\
+}\
+X86_TARGET(isa) static double triad##Isa(double *a, const double *b, const double *c, size_t count)\
+{\
+    const vec scalar = set1(3.);\
+    for (size_t i = 0; i < count; i += width * 2)\
+    {\
+        store(a + i, add(load(b + i), mul(scalar, load(c + i))));\
+        store(a + i + width, add(load(b + i + width), mul(scalar, load(c + i + width))));\
+    }\
+    return 0.;\
+}\
+X86_TARGET(isa) static double writeNonTemporal##Isa(double *a, const double *, const double *, size_t count)\
+{\
+    const vec one = set1(1.);\
+    for (size_t i = 0; i < count; i += width * 4)\
+    {\
+        stream(a + i, one);\
+        stream(a + i + width, one);\
+        stream(a + i + width * 2, one);\
+        stream(a + i + width * 3, one);\
+    }\
+    fence();\
+    return 0.;\
+}\
+X86_TARGET(isa) static double copyNonTemporal##Isa(double *a, const double *b, const double *, size_t count)\
+{\
+    for (size_t i = 0; i < count; i += width * 4)\
+    {\
+        stream(a + i, load(b + i));\
+        stream(a + i + width, load(b + i + width));\
+        stream(a + i + width * 2, load(b + i + width * 2));\
+        stream(a + i + width * 3, load(b + i + width * 3));\
+    }\
+    fence();\
+    return 0.;\
+}\
+X86_TARGET(isa) static double triadNonTemporal##Isa(double *a, const double *b, const double *c, size_t count)\
+{\
+    const vec scalar = set1(3.);\
+    for (size_t i = 0; i < count; i += width * 2)\
+    {\
+        stream(a + i, add(load(b + i), mul(scalar, load(c + i))));\
+        stream(a + i + width, add(load(b + i + width), mul(scalar, load(c + i + width))));\
+    }\
+    fence();\
+    return 0.;\
+}
+
+DEFINE_BANDWIDTH_KERNELS(Sse2, "sse2", __m128d, 2,
+    _mm_load_pd, _mm_store_pd, _mm_stream_pd, _mm_add_pd, _mm_mul_pd, _mm_set1_pd, _mm_sfence)
+DEFINE_BANDWIDTH_KERNELS(Avx2, "avx2", __m256d, 4,
+    _mm256_load_pd, _mm256_store_pd, _mm256_stream_pd, _mm256_add_pd, _mm256_mul_pd, _mm256_set1_pd, _mm_sfence)
+DEFINE_BANDWIDTH_KERNELS(Avx512, "avx512f", __m512d, 8,
+    _mm512_load_pd, _mm512_store_pd, _mm512_stream_pd, _mm512_add_pd, _mm512_mul_pd, _mm512_set1_pd, _mm_sfence)
+
+#define BANDWIDTH_KERNEL_CANDIDATES(kernel, generic) {\
+    {x86DispatchTier::Generic, generic, "generic"},\
+    {x86DispatchTier::SSE2, kernel##Sse2, "sse2"},\
+    {x86DispatchTier::AVX2, kernel##Avx2, "avx2"},\
+    {x86DispatchTier::AVX512, kernel##Avx512, "avx512"}}
+
+static x86Dispatcher<BandwidthKernelFn> kernels[] = {
+    BANDWIDTH_KERNEL_CANDIDATES(read, readGeneric),
+    BANDWIDTH_KERNEL_CANDIDATES(write, writeGeneric),
+    BANDWIDTH_KERNEL_CANDIDATES(copy, copyGeneric),
+    BANDWIDTH_KERNEL_CANDIDATES(triad, triadGeneric),
+    BANDWIDTH_KERNEL_CANDIDATES(writeNonTemporal, writeGeneric),
+    BANDWIDTH_KERNEL_CANDIDATES(copyNonTemporal, copyGeneric),
+    BANDWIDTH_KERNEL_CANDIDATES(triadNonTemporal, triadGeneric)
+};
+
+const char *getBandwidthKernelName(x86BandwidthKernel kernel) noexcept
+{
+    return kernelNames[(int)kernel];
+}
+
+const char *getBandwidthKernelVariant(x86BandwidthKernel kernel) noexcept
+{
+    return kernels[(int)kernel].getName();
+}
+
+static std::vector<uint32_t> getProcessorOrder()
+{   // Distinct physical cores first, alternating packages
+    x86ProcessorTopology topology = getProcessorTopology();
+    std::vector<x86LogicalProcessor> processors;
+    for (const auto& cpu: topology.processors)
+    {
+        if (cpu.valid)
+            processors.push_back(cpu);
+    }
+    std::stable_sort(processors.begin(), processors.end(),
+        [](const x86LogicalProcessor& a, const x86LogicalProcessor& b)
+        {
+            if (a.smtId != b.smtId)
+                return a.smtId < b.smtId;
+            if (a.coreId != b.coreId)
+                return a.coreId < b.coreId;
+            return a.packageId < b.packageId;
+        });
+    std::vector<uint32_t> order;
+    for (const auto& cpu: processors)
+        order.push_back(cpu.processor);
+    if (order.empty())
+        order.push_back(0);
+    return order;
+}
+
+static const std::vector<uint32_t>& getCachedProcessorOrder()
+{
+    static const std::vector<uint32_t> order = getProcessorOrder();
+    return order;
+}
+
+std::vector<uint32_t> getBandwidthThreadCounts() noexcept
+{   // Powers of two and midpoints between them, and all processors
+    const uint32_t count = (uint32_t)getCachedProcessorOrder().size();
+    std::vector<uint32_t> counts;
+    for (uint32_t n = 1; n < count; n *= 2)
+    {
+        counts.push_back(n);
+        if ((n >= 2) && (n + n/2 < count))
+            counts.push_back(n + n/2);
+    }
+    counts.push_back(count);
+    return counts;
+}
+
+static uint64_t getWorkingSetSize(x86BandwidthLevel level, uint32_t numThreads) noexcept
+{
+    const x86ProcessorInfo& info = queryProcessorInfo(x86SectionVendor | x86SectionCaches);
+    x86CacheLevelInfo cache;
+    const uint64_t l1Size = getDataCacheLevel(info, 1, cache) ? cache.size : 32 * 1024;
+    const uint64_t l2Size = getDataCacheLevel(info, 2, cache) ? cache.size : 256 * 1024;
+    const uint64_t l3Size = getDataCacheLevel(info, 3, cache) ? cache.size : 8 * 1024 * 1024;
+    uint64_t size;
+    switch (level)
+    {   // Half of the cache leaves room for code, stack and other data
+    case x86BandwidthLevel::L1: size = l1Size/2; break;
+    case x86BandwidthLevel::L2: size = l2Size/2; break;
+    case x86BandwidthLevel::L3: size = l3Size/2/numThreads; break;
+    default: size = std::min<uint64_t>(std::max<uint64_t>(l3Size * 4, 256ull * 1024 * 1024), MAX_WORKING_SET)/numThreads;
+    }
+    return std::max<uint64_t>(size, BLOCK_SIZE * 3);
+}
+
+x86BandwidthResult measureMemoryBandwidth(x86BandwidthKernel kernel,
+    x86BandwidthLevel level, uint32_t numThreads)
+{
+    const std::vector<uint32_t>& order = getCachedProcessorOrder();
+    numThreads = std::max(std::min(numThreads, (uint32_t)order.size()), 1u);
+    x86BandwidthResult result = {kernel, level, numThreads, getWorkingSetSize(level, numThreads), 0.};
+    // Working set is split between three arrays
+    const size_t count = result.workingSetSize/3/BLOCK_SIZE * BLOCK_SIZE/sizeof(double);
+    const uint64_t passBytes = count * sizeof(double) * kernelArrays[(int)kernel];
+    const uint64_t passes = std::max<uint64_t>(TARGET_BYTES/passBytes, 2);
+    const BandwidthKernelFn fn = kernels[(int)kernel].get();
+    std::atomic<uint32_t> ready(0);
+    std::atomic<bool> start(false);
+    std::vector<std::chrono::steady_clock::time_point> ends(numThreads);
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        workers.emplace_back([&, i]()
+        {   // Allocate after pinning for the memory to be local to NUMA node
+            setThreadAffinity(order[i]);
+            std::vector<double> memory(count * 3 + ALIGNMENT/sizeof(double), 1.);
+            double *a = memory.data() + (ALIGNMENT - (uintptr_t)memory.data() % ALIGNMENT)/sizeof(double);
+            double *b = a + count, *c = b + count;
+            double sum = fn(a, b, c, count);
+            ready.fetch_add(1);
+            while (!start.load(std::memory_order_acquire))
+                ;
+            for (uint64_t pass = 0; pass < passes; ++pass)
+                sum += fn(a, b, c, count);
+            ends[i] = std::chrono::steady_clock::now();
+            static volatile double sink;
+            sink = sum;
+            (void)sink;
+        });
+    }
+    while (ready.load() < numThreads)
+        std::this_thread::yield();
+    const auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (auto& worker: workers)
+        worker.join();
+    const std::chrono::duration<double> elapsed = *std::max_element(ends.begin(), ends.end()) - begin;
+    result.bandwidth = (double)passBytes * passes * numThreads/elapsed.count()/1e+9;
+    return result;
+}
+
+uint32_t getBandwidthSaturationPoint(const std::vector<x86BandwidthResult>& results,
+    double threshold /* 0.95 */) noexcept
+{   // The least number of threads which reaches threshold of peak bandwidth
+    double peak = 0.;
+    for (const auto& result: results)
+        peak = std::max(peak, result.bandwidth);
+    uint32_t numThreads = 0;
+    for (const auto& result: results)
+    {
+        if ((result.bandwidth >= peak * threshold) && (!numThreads || result.numThreads < numThreads))
+            numThreads = result.numThreads;
+    }
+    return numThreads;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/* STREAM-style kernels, non-temporal variants bypass caches on store. */
+
+enum class x86BandwidthKernel : uint8_t
+{
+    Read, Write, Copy, Triad, WriteNonTemporal, CopyNonTemporal, TriadNonTemporal,
+    Count
+};
+
+/* Level of memory hierarchy which holds the working set. */
+
+enum class x86BandwidthLevel : uint8_t
+{
+    L1, L2, L3, DRAM,
+    Count
+};
+
+struct x86BandwidthResult
+{
+    x86BandwidthKernel kernel;
+    x86BandwidthLevel level;
+    uint32_t numThreads;
+    uint64_t workingSetSize;    // Per thread, in bytes
+    double bandwidth;           // In GB/s, all threads
+};
+
+/* */
+
+const char *getBandwidthKernelName(x86BandwidthKernel kernel) noexcept;
+const char *getBandwidthKernelVariant(x86BandwidthKernel kernel) noexcept;
+std::vector<uint32_t> getBandwidthThreadCounts() noexcept;
+
+/* Runs kernel on given number of threads concurrently, threads are pinned
+   to distinct physical cores first and to SMT siblings after that.
+   Working set size is derived from CPUID reported cache sizes. */
+
+x86BandwidthResult measureMemoryBandwidth(x86BandwidthKernel kernel,
+    x86BandwidthLevel level, uint32_t numThreads);
+uint32_t getBandwidthSaturationPoint(const std::vector<x86BandwidthResult>& results,
+    double threshold = 0.95) noexcept;
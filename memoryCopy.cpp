@@ -0,0 +1,394 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <vector>
+#include "memoryCopy.h"
+#include "cacheLine.h"
+#include "cpuDispatchx86.h"
+#include "microarchitecture.h"
+
+#define REP_MOVSB_THRESHOLD     2048    // With 16-byte vectors, scaled by vector size
+#define REP_STOSB_THRESHOLD     2048
+#define CALIBRATION_BYTES       (8ull * 1024 * 1024)    // Moved per timing of a size
+#define CALIBRATION_TRIALS      3
+#define MIN_REP_SIZE            256
+#define MAX_REP_SIZE            (4ull * 1024 * 1024)
+#define MIN_STREAM_SIZE         (1ull * 1024 * 1024)
+#define MAX_STREAM_SIZE         (32ull * 1024 * 1024)
+
+typedef void (*CopyFn)(void *destination, const void *source, size_t size);
+typedef void (*FillFn)(void *destination, int value, size_t size);
+
+static void copyGeneric(void *destination, const void *source, size_t size)
+{
+    memcpy(destination, source, size);
+}
+
+static void fillGeneric(void *destination, int value, size_t size)
+{
+    memset(destination, value, size);
+}
+
+static void copyRepMovsb(void *destination, const void *source, size_t size)
+{
+#ifdef _MSC_VER
+    __movsb((unsigned char *)destination, (const unsigned char *)source, size);
+#else
+    asm volatile("rep movsb" : "+D"(destination), "+S"(source), "+c"(size) : : "memory");
+#endif
+}
+
+static void fillRepStosb(void *destination, int value, size_t size)
+{
+#ifdef _MSC_VER
+    __stosb((unsigned char *)destination, (unsigned char)value, size);
+#else
+    asm volatile("rep stosb" : "+D"(destination), "+c"(size) : "a"(value) : "memory");
+#endif
+}
+
+/* Defines kernels for vector ISA. Loops are unrolled by four vectors, the
+   last vector is loaded up front and stored at the end, overlapping the
+   previous ones, so that there is no scalar tail. Streaming variants
+   store the unaligned head the same way and align destination for the
+   streaming stores. */
+
+#define DEFINE_COPY_KERNELS(Isa, isa, vec, loadu, storeu, stream, set1, fence)\
+X86_TARGET(isa) static void copy##Isa(void *destination, const void *source, size_t size)\
+{\
+    constexpr size_t width = sizeof(vec);\
+    char *d = (char *)destination;\
+    const char *s = (const char *)source;\
+    if (size < width)\
+    {\
+        memcpy(d, s, size);\
+        return;\
+    }\
+    const vec last = loadu((const vec *)(s + size - width));\
+    size_t i = 0;\
+    for (; i + width * 4 <= size; i += width * 4)\
+    {\
+        const vec v0 = loadu((const vec *)(s + i));\
+        const vec v1 = loadu((const vec *)(s + i + width));\
+        const vec v2 = loadu((const vec *)(s + i + width * 2));\
+        const vec v3 = loadu((const vec *)(s + i + width * 3));\
+        storeu((vec *)(d + i), v0);\
+        storeu((vec *)(d + i + width), v1);\
+        storeu((vec *)(d + i + width * 2), v2);\
+        storeu((vec *)(d + i + width * 3), v3);\
+    }\
+    for (; i + width <= size; i += width)\
+        storeu((vec *)(d + i), loadu((const vec *)(s + i)));\
+    storeu((vec *)(d + size - width), last);\
+}\
+X86_TARGET(isa) static void fill##Isa(void *destination, int value, size_t size)\
+{\
+    constexpr size_t width = sizeof(vec);\
+    char *d = (char *)destination;\
+    if (size < width)\
+    {\
+        memset(d, value, size);\
+        return;\
+    }\
+    const vec v = set1((char)value);\
+    size_t i = 0;\
+    for (; i + width * 4 <= size; i += width * 4)\
+    {\
+        storeu((vec *)(d + i), v);\
+        storeu((vec *)(d + i + width), v);\
+        storeu((vec *)(d + i + width * 2), v);\
+        storeu((vec *)(d + i + width * 3), v);\
+    }\
+    for (; i + width <= size; i += width)\
+        storeu((vec *)(d + i), v);\
+    storeu((vec *)(d + size - width), v);\
+}\
+X86_TARGET(isa) static void copyNonTemporal##Isa(void *destination, const void *source, size_t size)\
+{\
+    constexpr size_t width = sizeof(vec);\
+    char *d = (char *)destination;\
+    const char *s = (const char *)source;\
+    if (size < width * 8)\
+    {\
+        copy##Isa(d, s, size);\
+        return;\
+    }\
+    const vec first = loadu((const vec *)s);\
+    const vec last = loadu((const vec *)(s + size - width));\
+    size_t i = width - (uintptr_t)d % width;\
+    for (; i + width * 4 <= size; i += width * 4)\
+    {\
+        const vec v0 = loadu((const vec *)(s + i));\
+        const vec v1 = loadu((const vec *)(s + i + width));\
+        const vec v2 = loadu((const vec *)(s + i + width * 2));\
+        const vec v3 = loadu((const vec *)(s + i + width * 3));\
+        stream((vec *)(d + i), v0);\
+        stream((vec *)(d + i + width), v1);\
+        stream((vec *)(d + i + width * 2), v2);\
+        stream((vec *)(d + i + width * 3), v3);\
+    }\
+    for (; i + width <= size; i += width)\
+        stream((vec *)(d + i), loadu((const vec *)(s + i)));\
+    fence();\
+    storeu((vec *)d, first);\
+    storeu((vec *)(d + size - width), last);\
+}\
+X86_TARGET(isa) static void fillNonTemporal##Isa(void *destination, int value, size_t size)\
+{\
+    constexpr size_t width = sizeof(vec);\
+    char *d = (char *)destination;\
+    if (size < width * 8)\
+    {\
+        fill##Isa(d, value, size);\
+        return;\
+    }\
+    const vec v = set1((char)value);\
+    size_t i = width - (uintptr_t)d % width;\
+    for (; i + width * 4 <= size; i += width * 4)\
+    {\
+        stream((vec *)(d + i), v);\
+        stream((vec *)(d + i + width), v);\
+        stream((vec *)(d + i + width * 2), v);\
+        stream((vec *)(d + i + width * 3), v);\
+    }\
+    for (; i + width <= size; i += width)\
+        stream((vec *)(d + i), v);\
+    fence();\
+    storeu((vec *)d, v);\
+    storeu((vec *)(d + size - width), v);\
+}
+
+DEFINE_COPY_KERNELS(Sse2, "sse2", __m128i,
+    _mm_loadu_si128, _mm_storeu_si128, _mm_stream_si128, _mm_set1_epi8, _mm_sfence)
+DEFINE_COPY_KERNELS(Avx2, "avx2", __m256i,
+    _mm256_loadu_si256, _mm256_storeu_si256, _mm256_stream_si256, _mm256_set1_epi8, _mm_sfence)
+DEFINE_COPY_KERNELS(Avx512, "avx512f", __m512i,
+    _mm512_loadu_si512, _mm512_storeu_si512, _mm512_stream_si512, _mm512_set1_epi8, _mm_sfence)
+
+/* 512-bit loops gain nothing where they lower the clock or execute as
+   two halves, 256-bit ones are as fast there. */
+
+#define COPY_KERNEL_CANDIDATES(kernel, generic) {\
+    {x86DispatchTier::Generic, generic, "generic"},\
+    {x86DispatchTier::SSE2, kernel##Sse2, "sse2"},\
+    {x86DispatchTier::AVX2, kernel##Avx2, "avx2"},\
+    {x86DispatchTier::AVX512, x86FeatureMask{}, kernel##Avx512, "avx512",\
+        x86TraitAvx512Downclock | x86TraitSplitVectors}}
+
+static x86Dispatcher<CopyFn> vectorCopy = COPY_KERNEL_CANDIDATES(copy, copyGeneric);
+static x86Dispatcher<CopyFn> nonTemporalCopy = COPY_KERNEL_CANDIDATES(copyNonTemporal, copyGeneric);
+static x86Dispatcher<FillFn> vectorFill = COPY_KERNEL_CANDIDATES(fill, fillGeneric);
+static x86Dispatcher<FillFn> nonTemporalFill = COPY_KERNEL_CANDIDATES(fillNonTemporal, fillGeneric);
+
+static std::atomic<const x86CopyPlan *> activePlan(nullptr);
+
+static uint64_t getVectorSize(const char *variant) noexcept
+{
+    if (!strcmp(variant, "avx512"))
+        return 64;
+    return strcmp(variant, "avx2") ? 16 : 32;
+}
+
+static x86CopyPlan getDefaultCopyPlan() noexcept
+{
+    const x86ProcessorInfo& info = queryProcessorInfo(x86SectionVendor | x86SectionFeatures | x86SectionCaches);
+    x86CopyPlan plan;
+    plan.vectorVariant = vectorCopy.getName();
+    plan.source = x86CopyPlanSource::Defaults;
+    uint64_t lastLevelSize = 0;
+    for (uint32_t level = 1; level <= 4; ++level)
+    {
+        x86CacheLevelInfo cache;
+        if (getDataCacheLevel(info, level, cache))
+            lastLevelSize = cache.size;
+    }
+    // Source and destination together fill the last level cache
+    plan.nonTemporalThreshold = lastLevelSize ? lastLevelSize/2 : std::numeric_limits<uint64_t>::max();
+    const uint32_t traits = getProcessorTraits();
+    const bool fastRepString = info.extendedFeatures.enhancedRepMovsbStosb && !(traits & x86TraitSlowRepMovsb);
+    const bool fastShortRepMovsb = info.extendedFeatures.fastShortRepMovsb && !(traits & x86TraitSlowShortRepMovsb);
+    if (fastRepString)
+    {   // Wider vectors keep up with REP MOVSB to larger sizes unless its startup is fast
+        plan.repMovsbThreshold = fastShortRepMovsb ? REP_MOVSB_THRESHOLD :
+            REP_MOVSB_THRESHOLD * getVectorSize(plan.vectorVariant)/16;
+        plan.repStosbThreshold = REP_STOSB_THRESHOLD;
+    } else
+    {
+        plan.repMovsbThreshold = plan.nonTemporalThreshold;
+        plan.repStosbThreshold = plan.nonTemporalThreshold;
+    }
+    plan.repMovsbThreshold = std::min(plan.repMovsbThreshold, plan.nonTemporalThreshold);
+    plan.repStosbThreshold = std::min(plan.repStosbThreshold, plan.nonTemporalThreshold);
+    return plan;
+}
+
+const x86CopyPlan& getCopyPlan() noexcept
+{
+    const x86CopyPlan *plan = activePlan.load(std::memory_order_acquire);
+    if (!plan)
+    {
+        static const x86CopyPlan defaultPlan = getDefaultCopyPlan();
+        const x86CopyPlan *expected = nullptr;
+        plan = activePlan.compare_exchange_strong(expected, &defaultPlan, std::memory_order_acq_rel) ?
+            &defaultPlan : expected;
+    }
+    return *plan;
+}
+
+x86CopyStrategy getCopyStrategy(const x86CopyPlan& plan, size_t size, bool fill /* false */) noexcept
+{
+    if (size >= plan.nonTemporalThreshold)
+        return x86CopyStrategy::NonTemporal;
+    if (size >= (fill ? plan.repStosbThreshold : plan.repMovsbThreshold))
+        return x86CopyStrategy::RepString;
+    return x86CopyStrategy::Vector;
+}
+
+void *copyMemory(void *destination, const void *source, size_t size) noexcept
+{
+    switch (getCopyStrategy(getCopyPlan(), size))
+    {
+    case x86CopyStrategy::RepString: copyRepMovsb(destination, source, size); break;
+    case x86CopyStrategy::NonTemporal: nonTemporalCopy(destination, source, size); break;
+    default: vectorCopy(destination, source, size);
+    }
+    return destination;
+}
+
+void *setMemory(void *destination, int value, size_t size) noexcept
+{
+    switch (getCopyStrategy(getCopyPlan(), size, true))
+    {
+    case x86CopyStrategy::RepString: fillRepStosb(destination, value, size); break;
+    case x86CopyStrategy::NonTemporal: nonTemporalFill(destination, value, size); break;
+    default: vectorFill(destination, value, size);
+    }
+    return destination;
+}
+
+/* Best of trials in nanoseconds per byte. */
+
+template<class Fn>
+static double timeBlock(const Fn& fn, uint64_t size)
+{
+    const uint64_t repeats = std::max<uint64_t>(CALIBRATION_BYTES/size, 2);
+    double best = std::numeric_limits<double>::max();
+    fn(); // Warm up
+    for (uint32_t trial = 0; trial < CALIBRATION_TRIALS; ++trial)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < repeats; ++i)
+            fn();
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+        best = std::min(best, elapsed.count()/(repeats * size));
+    }
+    return best;
+}
+
+/* Smallest size from which candidate is at least as fast as baseline at
+   every larger size, searched from the largest one. Returns ~0 if the
+   candidate loses at the largest size. */
+
+template<class Baseline, class Candidate>
+static uint64_t findCrossover(uint64_t minSize, uint64_t maxSize, const Baseline& baseline,
+    const Candidate& candidate)
+{
+    uint64_t crossover = std::numeric_limits<uint64_t>::max();
+    for (uint64_t size = maxSize; size >= minSize; size /= 2)
+    {
+        if (timeBlock([&]() { candidate(size); }, size) > timeBlock([&]() { baseline(size); }, size))
+            break;
+        crossover = size;
+    }
+    return crossover;
+}
+
+static x86CopyPlan measureCopyPlan()
+{
+    const x86ProcessorInfo& info = queryProcessorInfo(x86SectionFeatures);
+    x86CopyPlan plan = getDefaultCopyPlan();
+    plan.source = x86CopyPlanSource::Calibrated;
+    char *source = (char *)allocateAligned(MAX_STREAM_SIZE, 4096);
+    char *destination = (char *)allocateAligned(MAX_STREAM_SIZE, 4096);
+    if (!source || !destination)
+    {
+        freeAligned(source);
+        freeAligned(destination);
+        return getDefaultCopyPlan();
+    }
+    memset(source, 1, MAX_STREAM_SIZE);
+    memset(destination, 0, MAX_STREAM_SIZE);
+    const CopyFn copy = vectorCopy.get();
+    const FillFn fill = vectorFill.get();
+    const uint64_t repLimit = std::min<uint64_t>(MAX_REP_SIZE, plan.nonTemporalThreshold);
+    if (info.extendedFeatures.enhancedRepMovsbStosb && (repLimit >= MIN_REP_SIZE))
+    {   // REP string which loses at the largest size is disabled
+        plan.repMovsbThreshold = findCrossover(MIN_REP_SIZE, repLimit,
+            [&](uint64_t size) { copy(destination, source, size); },
+            [&](uint64_t size) { copyRepMovsb(destination, source, size); });
+        plan.repStosbThreshold = findCrossover(MIN_REP_SIZE, repLimit,
+            [&](uint64_t size) { fill(destination, 0, size); },
+            [&](uint64_t size) { fillRepStosb(destination, 0, size); });
+    }
+    // Streaming is compared with the strategy it replaces
+    const CopyFn streamCopy = nonTemporalCopy.get();
+    const uint64_t streamThreshold = findCrossover(MIN_STREAM_SIZE, MAX_STREAM_SIZE,
+        [&](uint64_t size)
+        {
+            if (size >= plan.repMovsbThreshold)
+                copyRepMovsb(destination, source, size);
+            else
+                copy(destination, source, size);
+        },
+        [&](uint64_t size) { streamCopy(destination, source, size); });
+    // Streaming which doesn't win in the range starts above it
+    const uint64_t previousThreshold = plan.nonTemporalThreshold;
+    plan.nonTemporalThreshold = (streamThreshold != std::numeric_limits<uint64_t>::max()) ? streamThreshold :
+        std::max<uint64_t>(plan.nonTemporalThreshold, MAX_STREAM_SIZE * 2);
+    // Disabled REP string stays disabled
+    if (plan.repMovsbThreshold >= previousThreshold)
+        plan.repMovsbThreshold = plan.nonTemporalThreshold;
+    if (plan.repStosbThreshold >= previousThreshold)
+        plan.repStosbThreshold = plan.nonTemporalThreshold;
+    plan.repMovsbThreshold = std::min(plan.repMovsbThreshold, plan.nonTemporalThreshold);
+    plan.repStosbThreshold = std::min(plan.repStosbThreshold, plan.nonTemporalThreshold);
+    freeAligned(source);
+    freeAligned(destination);
+    return plan;
+}
+
+const x86CopyPlan& calibrateCopyPlan()
+{
+    static const x86CopyPlan calibratedPlan = measureCopyPlan();
+    activePlan.store(&calibratedPlan, std::memory_order_release);
+    return calibratedPlan;
+}
+
+const char *stringifyCopyStrategy(x86CopyStrategy strategy) noexcept
+{
+    switch (strategy)
+    {
+    case x86CopyStrategy::Vector: return "Vector";
+    case x86CopyStrategy::RepString: return "REP string";
+    case x86CopyStrategy::NonTemporal: return "Non-temporal";
+    default: return "Unknown";
+    }
+}
+
+const char *stringifyCopyPlanSource(x86CopyPlanSource source) noexcept
+{
+    switch (source)
+    {
+    case x86CopyPlanSource::Defaults: return "Defaults";
+    case x86CopyPlanSource::Calibrated: return "Calibrated";
+    default: return "Unknown";
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/* Strategy which copies or fills a block of given size. */
+
+enum class x86CopyStrategy : uint8_t
+{
+    Vector,             // Unrolled loop of the widest usable vectors
+    RepString,          // REP MOVSB or REP STOSB
+    NonTemporal         // Vector loop with streaming stores which bypass caches
+};
+
+enum class x86CopyPlanSource : uint8_t
+{
+    Defaults,           // Derived from features, traits and cache sizes
+    Calibrated          // Crossovers measured on this host
+};
+
+/* Sizes below REP threshold use vector loop, sizes from non-temporal
+   threshold stream stores, REP string is used in between. Threshold
+   equal to the non-temporal one disables REP string, ~0 disables
+   streaming. */
+
+struct x86CopyPlan
+{
+    const char *vectorVariant;      // generic, sse2, avx2 or avx512
+    uint64_t repMovsbThreshold;     // In bytes
+    uint64_t repStosbThreshold;     // In bytes
+    uint64_t nonTemporalThreshold;  // In bytes, copies and fills
+    x86CopyPlanSource source;
+};
+
+/* Drop-in replacements of memcpy() and memset(), blocks must not overlap.
+   Default plan is used until calibration has finished. */
+
+void *copyMemory(void *destination, const void *source, size_t size) noexcept;
+void *setMemory(void *destination, int value, size_t size) noexcept;
+
+/* Default thresholds follow the ERMS and FSRM flags and the REP MOVSB
+   traits of the microarchitecture, streaming starts when source and
+   destination together exceed the last level cache. Calibration times
+   both sides of every crossover on the calling thread, it takes about
+   a hundred milliseconds and is performed once. */
+
+const x86CopyPlan& getCopyPlan() noexcept;
+const x86CopyPlan& calibrateCopyPlan();
+x86CopyStrategy getCopyStrategy(const x86CopyPlan& plan, size_t size, bool fill = false) noexcept;
+const char *stringifyCopyStrategy(x86CopyStrategy strategy) noexcept;
+const char *stringifyCopyPlanSource(x86CopyPlanSource source) noexcept;
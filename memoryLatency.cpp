@@ -0,0 +1,287 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fstream>
+#include <string>
+#endif
+#include <algorithm>
+#include <new>
+#include <random>
+#include <thread>
+#include "memoryLatency.h"
+#include "coreFrequency.h"
+#include "cpuInfox86.h"
+#include "threadAffinity.h"
+#include "cpuid.h"
+
+#define PAGE_SIZE       4096
+#define HUGE_PAGE_SIZE  (2 * 1024 * 1024)
+#define LOADS_PER_SIZE  (1 << 21)
+#define PLATEAU_STEP    1.3
+#define PAGE_WINDOW     8
+#define LINE_PAIR_SIZE  128
+
+static bool isLinePair(uint64_t a, uint64_t b, uint32_t lineSize) noexcept
+{
+    return (a != b) && (a * lineSize/LINE_PAIR_SIZE == b * lineSize/LINE_PAIR_SIZE);
+}
+
+static void buildCycle(char *buffer, uint64_t numLines, uint32_t lineSize, std::mt19937_64& rng)
+{   // Visit lines of a window of pages in random order before moving to the next random
+    // window, so that TLB misses are amortized while prefetch of adjacent lines is not
+    const uint64_t windowLines = std::max<uint64_t>(PAGE_WINDOW * PAGE_SIZE/lineSize, 1);
+    const uint64_t numWindows = (numLines + windowLines - 1)/windowLines; // Last one may be partial
+    std::vector<uint64_t> windows(numWindows), lines;
+    for (uint64_t i = 0; i < numWindows; ++i)
+        windows[i] = i;
+    std::shuffle(windows.begin(), windows.end(), rng);
+    std::vector<char *> order;
+    order.reserve(numLines);
+    for (uint64_t window: windows)
+    {
+        const uint64_t first = window * windowLines;
+        lines.resize(std::min(windowLines, numLines - first));
+        for (uint64_t i = 0; i < lines.size(); ++i)
+            lines[i] = first + i;
+        std::shuffle(lines.begin(), lines.end(), rng);
+        for (size_t i = 1; i < lines.size(); ++i)
+        {   // Line can't follow the other line of its 128-byte pair
+            if (!isLinePair(lines[i - 1], lines[i], lineSize))
+                continue;
+            if (i + 1 < lines.size())
+                std::swap(lines[i], lines[i + 1 + rng() % (lines.size() - i - 1)]);
+            else if (lines.size() > 2)
+                std::rotate(lines.begin(), lines.end() - 1, lines.end());
+        }
+        for (uint64_t line: lines)
+            order.push_back(buffer + line * lineSize);
+    }
+    for (size_t i = 0; i < order.size(); ++i)
+        *(char **)order[i] = order[(i + 1) % order.size()];
+}
+
+static void *chase(void *p, uint64_t loads) noexcept
+{
+    for (uint64_t i = 0; i < loads; i += 8)
+    {
+        p = *(void **)p; p = *(void **)p; p = *(void **)p; p = *(void **)p;
+        p = *(void **)p; p = *(void **)p; p = *(void **)p; p = *(void **)p;
+    }
+    return p;
+}
+
+static std::vector<uint64_t> getWorkingSetSizes(uint64_t minSize, uint64_t maxSize, uint32_t lineSize)
+{
+    std::vector<uint64_t> sizes;
+    for (uint64_t size = minSize; size <= maxSize; size *= 2)
+    {
+        sizes.push_back(size);
+        const uint64_t midpoint = (size + size/2)/lineSize * lineSize;
+        if (midpoint <= maxSize)
+            sizes.push_back(midpoint);
+    }
+    return sizes;
+}
+
+std::vector<x86LatencySample> measureMemoryLatency(uint64_t minSize, uint64_t maxSize,
+    uint32_t lineSize /* 64 */)
+{
+    std::vector<x86LatencySample> samples;
+    const uint64_t tscFrequency = getTscFrequency().frequency;
+    if (!tscFrequency || minSize < lineSize || maxSize < minSize)
+        return samples;
+    std::thread worker([&]()
+    {   // Memory is allocated by pinned thread to stay local to its node
+        if (!setThreadAffinity(getLogicalProcessors().front()))
+            return;
+        const double coreFrequency = (double)measureCoreFrequency(20000000ull);
+        std::vector<char> memory;
+        try
+        {
+            memory.resize(maxSize + PAGE_SIZE);
+        } catch (const std::bad_alloc&)
+        {
+            return;
+        }
+        char *buffer = memory.data() + (PAGE_SIZE - (uintptr_t)memory.data() % PAGE_SIZE);
+        std::mt19937_64 rng(maxSize);
+        void *p = buffer;
+        for (uint64_t size: getWorkingSetSizes(minSize, maxSize, lineSize))
+        {
+            const uint64_t numLines = size/lineSize;
+            try
+            {
+                buildCycle(buffer, numLines, lineSize, rng);
+            } catch (const std::bad_alloc&)
+            {   // Sweep ends at the size which can't be ordered
+                break;
+            }
+            p = chase(buffer, std::min<uint64_t>(numLines * 2, LOADS_PER_SIZE)); // Warm up
+            const uint64_t begin = __rdtsc();
+            p = chase(p, LOADS_PER_SIZE);
+            const uint64_t end = __rdtsc();
+            x86LatencySample sample;
+            sample.workingSetSize = size;
+            sample.nanoseconds = (end - begin) * 1e+9/tscFrequency/LOADS_PER_SIZE;
+            sample.cycles = sample.nanoseconds * coreFrequency/1e+9;
+            samples.push_back(sample);
+        }
+        static void * volatile result;
+        result = p;
+        (void)result;
+    });
+    worker.join();
+    return samples;
+}
+
+/* Page aligned memory, which is unmapped on destruction. */
+
+class PageBuffer
+{
+public:
+    PageBuffer(uint64_t size, x86PageBacking backing) noexcept:
+        base(nullptr), data(nullptr), size(size)
+    {
+    #ifdef _WIN32
+        if (x86PageBacking::Small == backing)
+            base = (char *)VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        data = base;
+    #else
+        // Align to huge page, so that the whole range can be backed by them
+        this->size = size + HUGE_PAGE_SIZE;
+        void *ptr = mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == ptr)
+            return;
+        base = (char *)ptr;
+        data = base + (HUGE_PAGE_SIZE - (uintptr_t)base % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+        const int advice = (x86PageBacking::Huge == backing) ? MADV_HUGEPAGE : MADV_NOHUGEPAGE;
+        if (madvise(data, size, advice))
+            data = nullptr;
+    #endif
+    }
+
+    ~PageBuffer()
+    {
+        if (!base)
+            return;
+    #ifdef _WIN32
+        VirtualFree(base, 0, MEM_RELEASE);
+    #else
+        munmap(base, size);
+    #endif
+    }
+
+    char *get() const noexcept { return data; }
+
+private:
+    char *base;
+    char *data;
+    uint64_t size;
+};
+
+static bool isPageBackingAvailable(x86PageBacking backing)
+{
+    if (x86PageBacking::Small == backing)
+        return true;
+#ifdef _WIN32
+    return false;
+#else
+    // Selected mode is enclosed in brackets, e.g. "always [madvise] never"
+    std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string modes;
+    std::getline(file, modes);
+    return !modes.empty() && (modes.find("[never]") == std::string::npos);
+#endif
+}
+
+static char *buildPageCycle(char *buffer, uint64_t numPages, uint32_t lineSize, std::mt19937_64& rng)
+{
+    const uint32_t linesPerPage = PAGE_SIZE/lineSize;
+    std::vector<uint32_t> pages(numPages);
+    for (uint64_t i = 0; i < numPages; ++i)
+        pages[i] = (uint32_t)i;
+    std::shuffle(pages.begin(), pages.end(), rng);
+    std::vector<char *> order;
+    order.reserve(numPages);
+    for (uint32_t page: pages)
+        order.push_back(buffer + (uint64_t)page * PAGE_SIZE + rng() % linesPerPage * lineSize);
+    for (size_t i = 0; i < order.size(); ++i)
+        *(char **)order[i] = order[(i + 1) % order.size()];
+    return order.front();
+}
+
+std::vector<x86TlbLatencySample> measureTlbLatency(uint64_t minPages, uint64_t maxPages,
+    x86PageBacking backing)
+{
+    std::vector<x86TlbLatencySample> samples;
+    const uint64_t tscFrequency = getTscFrequency().frequency;
+    if (!tscFrequency || !minPages || maxPages < minPages || !isPageBackingAvailable(backing))
+        return samples;
+    std::thread worker([&]()
+    {
+        if (!setThreadAffinity(getLogicalProcessors().front()))
+            return;
+        PageBuffer memory(maxPages * PAGE_SIZE, backing);
+        char *buffer = memory.get();
+        if (!buffer)
+            return;
+        const double coreFrequency = (double)measureCoreFrequency(20000000ull);
+        // Fault in the whole range before measurement
+        std::fill(buffer, buffer + maxPages * PAGE_SIZE, 0);
+        std::mt19937_64 rng(maxPages);
+        void *p = buffer;
+        for (uint64_t numPages: getWorkingSetSizes(minPages, maxPages, 1))
+        {
+            char *first = buildPageCycle(buffer, numPages, 64, rng);
+            p = chase(first, std::min<uint64_t>(numPages * 2, LOADS_PER_SIZE)); // Warm up
+            const uint64_t begin = __rdtsc();
+            p = chase(p, LOADS_PER_SIZE);
+            const uint64_t end = __rdtsc();
+            x86TlbLatencySample sample;
+            sample.numPages = numPages;
+            sample.nanoseconds = (end - begin) * 1e+9/tscFrequency/LOADS_PER_SIZE;
+            sample.cycles = sample.nanoseconds * coreFrequency/1e+9;
+            samples.push_back(sample);
+        }
+        static void * volatile result;
+        result = p;
+        (void)result;
+    });
+    worker.join();
+    return samples;
+}
+
+std::vector<x86LatencyPlateau> detectLatencyPlateaus(const std::vector<x86LatencySample>& samples)
+{
+    std::vector<x86LatencyPlateau> plateaus;
+    std::vector<std::vector<const x86LatencySample *>> members;
+    for (const auto& sample: samples)
+    {   // Start next plateau when latency steps up from the previous sample,
+        // gradual increase within a level doesn't split it
+        if (members.empty() || (sample.nanoseconds > members.back().back()->nanoseconds * PLATEAU_STEP))
+            members.emplace_back();
+        members.back().push_back(&sample);
+    }
+    for (size_t i = 0; i < members.size(); ++i)
+    {   // Single sample is a transition between levels, unless it's the last one
+        std::vector<const x86LatencySample *>& plateau = members[i];
+        if ((plateau.size() < 2) && (i + 1 < members.size()))
+            continue;
+        x86LatencyPlateau level;
+        level.minSize = plateau.front()->workingSetSize;
+        level.maxSize = plateau.back()->workingSetSize;
+        std::sort(plateau.begin(), plateau.end(),
+            [](const x86LatencySample *a, const x86LatencySample *b)
+            {
+                return a->nanoseconds < b->nanoseconds;
+            });
+        const x86LatencySample *median = plateau[plateau.size()/2];
+        level.nanoseconds = median->nanoseconds;
+        level.cycles = median->cycles;
+        plateaus.push_back(level);
+    }
+    return plateaus;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/* Average latency of dependent load at given working set size. */
+
+struct x86LatencySample
+{
+    uint64_t workingSetSize;    // In bytes
+    double nanoseconds;         // Per load
+    double cycles;              // Per load, in core clocks
+};
+
+/* Range of working set sizes with approximately the same latency. */
+
+struct x86LatencyPlateau
+{
+    uint64_t minSize;           // In bytes
+    uint64_t maxSize;           // In bytes, estimated capacity of the level
+    double nanoseconds;
+    double cycles;
+};
+
+/* Chases pointers through random cyclic permutation of cache lines,
+   which defeats hardware prefetchers. Lines of a window of 8 pages are
+   visited together to exclude cost of TLB misses, and the other line of
+   a 128-byte pair never comes next, so that spatial prefetcher doesn't
+   hide misses. Working set grows from minSize to maxSize by powers of
+   two and midpoints between them. Runs on a thread pinned to the first
+   allowed logical processor, cycles are derived from effective core
+   clock measured before the sweep. Empty vector is returned if the
+   thread can't be pinned or memory can't be allocated. */
+
+std::vector<x86LatencySample> measureMemoryLatency(uint64_t minSize, uint64_t maxSize,
+    uint32_t lineSize = 64);
+std::vector<x86LatencyPlateau> detectLatencyPlateaus(const std::vector<x86LatencySample>& samples);
+
+/* Backing of the working set for TLB reach measurement. Huge pages are
+   transparent 2M pages requested with madvise(), they are available on
+   Linux only unless disabled by the system. */
+
+enum class x86PageBacking : uint8_t
+{
+    Small, Huge
+};
+
+struct x86TlbLatencySample
+{
+    uint64_t numPages;          // Touched 4K pages
+    double nanoseconds;         // Per load
+    double cycles;              // Per load, in core clocks
+};
+
+/* Chases pointers through one line of every 4K page in random page order,
+   so that every load needs its own translation. Line offsets within pages
+   are random to spread lines over cache sets. Page walk cost appears when
+   the number of pages exceeds reach of a TLB level, huge pages move the
+   step to 512 times larger count. Runs pinned like measureMemoryLatency().
+   Returns empty vector if backing is not available or the thread can't
+   be pinned. */
+
+std::vector<x86TlbLatencySample> measureTlbLatency(uint64_t minPages, uint64_t maxPages,
+    x86PageBacking backing);
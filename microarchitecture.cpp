@@ -0,0 +1,191 @@
+#include "microarchitecture.h"
+#include "cpuid.h"
+
+#define UARCH(vendor, family, minModel, maxModel, name, traits, avx512, vectorWidth, storePorts)\
+    {x86VendorId::vendor, family, minModel, maxModel, name, traits, x86Avx512Frequency::avx512, vectorWidth, storePorts}
+#define INTEL(model, name, traits, avx512, vectorWidth, storePorts)\
+    UARCH(Intel, 0x6, model, model, name, traits, avx512, vectorWidth, storePorts)
+#define AMD(family, minModel, maxModel, name, traits, avx512, vectorWidth, storePorts)\
+    UARCH(AMD, family, minModel, maxModel, name, traits, avx512, vectorWidth, storePorts)
+
+#define PDEP            x86TraitMicrocodedPdepPext
+#define SPLIT           x86TraitSplitVectors
+#define SLOW_REP        (x86TraitSlowRepMovsb | x86TraitSlowShortRepMovsb)
+#define SLOW_SHORT_REP  x86TraitSlowShortRepMovsb
+
+/* Traits are taken from optimization manuals and public measurements.
+   Ranges are searched in order, so that narrow ranges go first. */
+
+static constexpr x86Microarchitecture microarchitectures[] = {
+    // Intel Core
+    INTEL(0x1A, "Nehalem", SLOW_REP, Unsupported, 128, 1),
+    INTEL(0x1E, "Nehalem", SLOW_REP, Unsupported, 128, 1),
+    INTEL(0x1F, "Nehalem", SLOW_REP, Unsupported, 128, 1),
+    INTEL(0x2E, "Nehalem-EX", SLOW_REP, Unsupported, 128, 1),
+    INTEL(0x25, "Westmere", SLOW_REP, Unsupported, 128, 1),
+    INTEL(0x2C, "Westmere-EP", SLOW_REP, Unsupported, 128, 1),
+    INTEL(0x2F, "Westmere-EX", SLOW_REP, Unsupported, 128, 1),
+    INTEL(0x2A, "Sandy Bridge", SLOW_REP, Unsupported, 256, 1),
+    INTEL(0x2D, "Sandy Bridge-EP", SLOW_REP, Unsupported, 256, 1),
+    INTEL(0x3A, "Ivy Bridge", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x3E, "Ivy Bridge-EP", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x3C, "Haswell", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x3F, "Haswell-EP", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x45, "Haswell", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x46, "Haswell", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x3D, "Broadwell", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x47, "Broadwell", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x4F, "Broadwell-EP", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x56, "Broadwell-DE", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x4E, "Skylake", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x5E, "Skylake", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x55, "Skylake-SP", SLOW_SHORT_REP, LargeDrop, 512, 1),
+    INTEL(0x8E, "Kaby Lake", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x9E, "Coffee Lake", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0xA5, "Comet Lake", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0xA6, "Comet Lake", SLOW_SHORT_REP, Unsupported, 256, 1),
+    INTEL(0x66, "Cannon Lake", SLOW_SHORT_REP, LargeDrop, 512, 1),
+    INTEL(0x7D, "Ice Lake", 0, SmallDrop, 512, 2),
+    INTEL(0x7E, "Ice Lake", 0, SmallDrop, 512, 2),
+    INTEL(0x6A, "Ice Lake-SP", 0, SmallDrop, 512, 2),
+    INTEL(0x6C, "Ice Lake-D", 0, SmallDrop, 512, 2),
+    INTEL(0x8C, "Tiger Lake", 0, SmallDrop, 512, 2),
+    INTEL(0x8D, "Tiger Lake", 0, SmallDrop, 512, 2),
+    INTEL(0xA7, "Rocket Lake", 0, SmallDrop, 512, 2),
+    INTEL(0x97, "Alder Lake", 0, Unsupported, 256, 2),
+    INTEL(0x9A, "Alder Lake", 0, Unsupported, 256, 2),
+    INTEL(0xB7, "Raptor Lake", 0, Unsupported, 256, 2),
+    INTEL(0xBA, "Raptor Lake", 0, Unsupported, 256, 2),
+    INTEL(0xBF, "Raptor Lake", 0, Unsupported, 256, 2),
+    INTEL(0xAA, "Meteor Lake", 0, Unsupported, 256, 2),
+    INTEL(0xAC, "Meteor Lake", 0, Unsupported, 256, 2),
+    INTEL(0xBD, "Lunar Lake", 0, Unsupported, 256, 2),
+    INTEL(0xC5, "Arrow Lake", 0, Unsupported, 256, 2),
+    INTEL(0xC6, "Arrow Lake", 0, Unsupported, 256, 2),
+    INTEL(0x8F, "Sapphire Rapids", 0, SmallDrop, 512, 2),
+    INTEL(0xCF, "Emerald Rapids", 0, SmallDrop, 512, 2),
+    INTEL(0xAD, "Granite Rapids", 0, SmallDrop, 512, 2),
+    INTEL(0xAE, "Granite Rapids-D", 0, SmallDrop, 512, 2),
+    // Intel Atom and Xeon Phi
+    INTEL(0x5C, "Goldmont", SLOW_SHORT_REP, Unsupported, 128, 1),
+    INTEL(0x5F, "Goldmont", SLOW_SHORT_REP, Unsupported, 128, 1),
+    INTEL(0x7A, "Goldmont Plus", SLOW_SHORT_REP, Unsupported, 128, 1),
+    INTEL(0x86, "Tremont", SLOW_SHORT_REP, Unsupported, 128, 2),
+    INTEL(0x96, "Tremont", SLOW_SHORT_REP, Unsupported, 128, 2),
+    INTEL(0x9C, "Tremont", SLOW_SHORT_REP, Unsupported, 128, 2),
+    INTEL(0xBE, "Gracemont", SPLIT, Unsupported, 128, 2),
+    INTEL(0xAF, "Crestmont", SPLIT, Unsupported, 128, 2),
+    INTEL(0x57, "Knights Landing", SLOW_SHORT_REP | SPLIT, LargeDrop, 512, 1),
+    INTEL(0x85, "Knights Mill", SLOW_SHORT_REP | SPLIT, LargeDrop, 512, 1),
+    // AMD
+    AMD(0x10, 0x00, 0xFF, "K10", SLOW_REP, Unsupported, 128, 1),
+    AMD(0x14, 0x00, 0xFF, "Bobcat", SLOW_REP, Unsupported, 64, 1),
+    AMD(0x15, 0x00, 0x0F, "Bulldozer", SLOW_REP | SPLIT, Unsupported, 128, 1),
+    AMD(0x15, 0x10, 0x1F, "Piledriver", SLOW_REP | SPLIT, Unsupported, 128, 1),
+    AMD(0x15, 0x30, 0x3F, "Steamroller", SLOW_REP | SPLIT, Unsupported, 128, 1),
+    AMD(0x15, 0x60, 0x7F, "Excavator", SLOW_REP | SPLIT, Unsupported, 128, 1),
+    AMD(0x16, 0x00, 0x0F, "Jaguar", SLOW_REP | SPLIT, Unsupported, 128, 1),
+    AMD(0x16, 0x30, 0x3F, "Puma", SLOW_REP | SPLIT, Unsupported, 128, 1),
+    AMD(0x17, 0x08, 0x08, "Zen+", PDEP | SLOW_REP | SPLIT, Unsupported, 128, 1),
+    AMD(0x17, 0x18, 0x18, "Zen+", PDEP | SLOW_REP | SPLIT, Unsupported, 128, 1),
+    AMD(0x17, 0x00, 0x2F, "Zen", PDEP | SLOW_REP | SPLIT, Unsupported, 128, 1),
+    AMD(0x17, 0x30, 0xFF, "Zen 2", PDEP | SLOW_REP, Unsupported, 256, 1),
+    AMD(0x19, 0x00, 0x0F, "Zen 3", 0, Unsupported, 256, 2),
+    AMD(0x19, 0x10, 0x1F, "Zen 4", SPLIT, NoDrop, 256, 2),
+    AMD(0x19, 0x20, 0x5F, "Zen 3", 0, Unsupported, 256, 2),
+    AMD(0x19, 0x60, 0x7F, "Zen 4", SPLIT, NoDrop, 256, 2),
+    AMD(0x19, 0xA0, 0xAF, "Zen 4", SPLIT, NoDrop, 256, 2),
+    AMD(0x1A, 0x20, 0x2F, "Zen 5", SPLIT, NoDrop, 256, 2),
+    AMD(0x1A, 0x60, 0x7F, "Zen 5", SPLIT, NoDrop, 256, 2),
+    AMD(0x1A, 0x00, 0xFF, "Zen 5", 0, NoDrop, 512, 2),
+    // Zen licensed to Hygon
+    UARCH(Hygon, 0x18, 0x00, 0xFF, "Dhyana", PDEP | SLOW_REP | SPLIT, Unsupported, 128, 1)
+};
+
+static constexpr uint32_t numMicroarchitectures = sizeof(microarchitectures)/sizeof(microarchitectures[0]);
+
+constexpr bool isMicroarchitectureTableValid() noexcept
+{   // Downclock is derived from the frequency license
+    for (uint32_t i = 0; i < numMicroarchitectures; ++i)
+    {
+        if ((microarchitectures[i].minModel > microarchitectures[i].maxModel) ||
+            (microarchitectures[i].traits & x86TraitAvx512Downclock))
+            return false;
+    }
+    return true;
+}
+
+static_assert(isMicroarchitectureTableValid(), "Microarchitecture table has invalid entry");
+
+uint32_t getDisplayFamily(const x86ProcessorSignature& signature) noexcept
+{
+    return signature.familyId + ((0xF == signature.familyId) ? signature.extendedFamilyId : 0);
+}
+
+uint32_t getDisplayModel(const x86ProcessorSignature& signature) noexcept
+{
+    if ((0x6 == signature.familyId) || (0xF == signature.familyId))
+        return (signature.extendedModelId << 4) | signature.model;
+    return signature.model;
+}
+
+const x86Microarchitecture *findMicroarchitecture(const x86ProcessorInfo& info) noexcept
+{
+    const uint32_t family = getDisplayFamily(info.signature);
+    const uint32_t model = getDisplayModel(info.signature);
+    for (const auto& microarchitecture: microarchitectures)
+    {
+        if ((microarchitecture.vendor == info.vendorId) && (microarchitecture.family == family) &&
+            (model >= microarchitecture.minModel) && (model <= microarchitecture.maxModel))
+            return &microarchitecture;
+    }
+    return nullptr;
+}
+
+uint32_t getMicroarchitectureTraits(const x86Microarchitecture& microarchitecture) noexcept
+{
+    uint32_t traits = microarchitecture.traits;
+    if (x86Avx512Frequency::LargeDrop == microarchitecture.avx512Frequency)
+        traits |= x86TraitAvx512Downclock;
+    return traits;
+}
+
+static uint32_t readProcessorTraits() noexcept
+{
+    const x86Microarchitecture *microarchitecture =
+        findMicroarchitecture(queryProcessorInfo(x86SectionVendor | x86SectionFeatures));
+    return microarchitecture ? getMicroarchitectureTraits(*microarchitecture) : 0u;
+}
+
+uint32_t getProcessorTraits() noexcept
+{   // Replayed processor may change, only the host is cached
+    if (getCpuIdSource())
+        return readProcessorTraits();
+    static const uint32_t traits = readProcessorTraits();
+    return traits;
+}
+
+const char *stringifyAvx512Frequency(x86Avx512Frequency frequency) noexcept
+{
+    switch (frequency)
+    {
+    case x86Avx512Frequency::Unsupported: return "Not supported";
+    case x86Avx512Frequency::LargeDrop: return "Large drop";
+    case x86Avx512Frequency::SmallDrop: return "Small drop";
+    case x86Avx512Frequency::NoDrop: return "No drop";
+    default: return "Unknown";
+    }
+}
+
+const char *stringifyMicroarchitectureTrait(x86MicroarchitectureTrait trait) noexcept
+{
+    switch (trait)
+    {
+    case x86TraitMicrocodedPdepPext: return "Microcoded PDEP/PEXT";
+    case x86TraitAvx512Downclock: return "AVX-512 downclock";
+    case x86TraitSplitVectors: return "Split vectors";
+    case x86TraitSlowRepMovsb: return "Slow REP MOVSB";
+    case x86TraitSlowShortRepMovsb: return "Slow short REP MOVSB";
+    default: return "Unknown";
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include "cpuInfox86.h"
+
+/* Family and model as shown by vendors: extended family is added to 0Fh,
+   extended model is prepended for families 06h and 0Fh and above. */
+
+uint32_t getDisplayFamily(const x86ProcessorSignature& signature) noexcept;
+uint32_t getDisplayModel(const x86ProcessorSignature& signature) noexcept;
+
+/* Frequency license of 512-bit instructions. */
+
+enum class x86Avx512Frequency : uint8_t
+{
+    Unsupported,        // No AVX-512 or fused off
+    LargeDrop,          // Light 512-bit instructions already lower the clock
+    SmallDrop,          // Only heavy 512-bit instructions lower the clock a little
+    NoDrop              // 512-bit instructions run at the scalar clock
+};
+
+/* Traits which make an implementation slow even though the feature bits
+   allow it. Dispatch candidates can avoid parts with any of them. */
+
+enum x86MicroarchitectureTrait
+{
+    x86TraitMicrocodedPdepPext = 0x1,   // PDEP/PEXT take tens to hundreds of cycles
+    x86TraitAvx512Downclock = 0x2,      // Avx512Frequency::LargeDrop
+    x86TraitSplitVectors = 0x4,         // The widest vectors execute as two halves
+    x86TraitSlowRepMovsb = 0x8,         // Vector loops beat REP MOVSB on large copies
+    x86TraitSlowShortRepMovsb = 0x10    // Startup cost of REP MOVSB dominates short copies
+};
+
+/* Entry of the microarchitecture database, models are inclusive ranges
+   of display model. */
+
+struct x86Microarchitecture
+{
+    x86VendorId vendor;
+    uint16_t family;
+    uint8_t minModel;
+    uint8_t maxModel;
+    const char *name;
+    uint32_t traits;                    // x86MicroarchitectureTrait, Avx512Downclock excluded
+    x86Avx512Frequency avx512Frequency;
+    uint16_t vectorWidth;               // Native width of vector execution units in bits
+    uint8_t storePorts;                 // Stores per clock which may forward to loads
+};
+
+/* Returns null if family and model are not in the database. */
+
+const x86Microarchitecture *findMicroarchitecture(const x86ProcessorInfo& info) noexcept;
+uint32_t getMicroarchitectureTraits(const x86Microarchitecture& microarchitecture) noexcept;
+
+/* Traits of this host, zero if the microarchitecture is unknown. */
+
+uint32_t getProcessorTraits() noexcept;
+const char *stringifyAvx512Frequency(x86Avx512Frequency frequency) noexcept;
+const char *stringifyMicroarchitectureTrait(x86MicroarchitectureTrait trait) noexcept;
@@ -1,37 +1,357 @@
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <streambuf>
 #include <string>
 #include <cstring>
+#include <type_traits>
+#include <vector>
+
+/* Report is accumulated in a single preallocated buffer and written
+   to stdout at once by flushOutput(). Text format keeps the layout for
+   humans, structured formats are built from the same calls: headings
+   become sections, printLn() becomes a field, printString() ending with
+   a colon names the group of the following fields. */
+
+enum class OutputFormat : uint8_t
+{
+    Text, Json, Csv, Prometheus
+};
+
+/* Yes/No in text, true/false or 1/0 in structured formats. */
+
+struct Boolean
+{
+    bool value;
+};
+
+inline std::ostream& operator<<(std::ostream& stream, Boolean boolean)
+{
+    return stream << (boolean.value ? "Yes" : "No");
+}
+
+class OutputBuffer: public std::streambuf
+{
+public:
+    explicit OutputBuffer(size_t capacity) { data.reserve(capacity); }
+    std::string& get() noexcept { return data; }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (c != traits_type::eof())
+            data.push_back((char)c);
+        return c;
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        data.append(s, (size_t)n);
+        return n;
+    }
+
+private:
+    std::string data;
+};
 
 static std::streamsize width = 0;
+static OutputBuffer outputBuffer(64 * 1024);
+static std::ostream output(&outputBuffer);
+static OutputFormat outputFormat = OutputFormat::Text;
+static std::string section, group;
+static std::vector<std::string> sectionKeys;
+static uint32_t numSections = 0;
+static bool tableHeader = false;
+static std::vector<std::string> tableColumns;
+static std::string tableName;
+static uint32_t tableRow = 0;
+
+enum class FieldType : uint8_t
+{
+    Number, Bool, String
+};
 
 void setFieldWidth(std::streamsize fieldWidth)
 {
     width = fieldWidth;
 }
 
+void setOutputFormat(OutputFormat format)
+{
+    outputFormat = format;
+}
+
+OutputFormat getOutputFormat()
+{
+    return outputFormat;
+}
+
+void flushOutput()
+{   // Structured formats are closed before the write
+    std::string& data = outputBuffer.get();
+    if (OutputFormat::Json == outputFormat)
+    {
+        if (tableHeader)
+            data += "]";
+        data += numSections ? "\n  }\n}\n" : "{}\n";
+        numSections = 0;
+        tableHeader = false;
+    }
+    size_t written = 0;
+    while (written < data.size())
+    {
+    #ifdef _WIN32
+        const int n = _write(1, data.data() + written, (unsigned)(data.size() - written));
+    #else
+        const ssize_t n = write(1, data.data() + written, data.size() - written);
+    #endif
+        if (n <= 0)
+            break;
+        written += (size_t)n;
+    }
+    data.clear();
+}
+
+static std::string trimKey(const char *description)
+{
+    std::string key(description);
+    while (!key.empty() && ((' ' == key.back()) || (':' == key.back()) || ('\n' == key.back())))
+        key.pop_back();
+    size_t begin = 0;
+    while ((begin < key.size()) && (('\n' == key[begin]) || (' ' == key[begin])))
+        ++begin;
+    return key.substr(begin);
+}
+
+static void writeEscaped(const std::string& str, char quote)
+{
+    std::string& data = outputBuffer.get();
+    data += quote;
+    for (char c: str)
+    {
+        if ((c == quote) || ('\\' == c))
+        {   // CSV doubles quotes, others use backslash
+            data += ('"' == quote && OutputFormat::Csv == outputFormat) ? '"' : '\\';
+            data += c;
+        } else if ((unsigned char)c >= 0x20)
+            data += c;
+    }
+    data += quote;
+}
+
+static std::string metricName(const std::string& str)
+{
+    std::string name;
+    for (char c: str)
+    {
+        if (isalnum((unsigned char)c))
+            name += (char)tolower((unsigned char)c);
+        else if (!name.empty() && ('_' != name.back()))
+            name += '_';
+    }
+    while (!name.empty() && ('_' == name.back()))
+        name.pop_back();
+    return name;
+}
+
+static std::string uniqueKey(const std::string& description)
+{   // Groups of fields may repeat within section
+    std::string key = group.empty() ? description : group + " " + description;
+    const std::string base = key;
+    for (uint32_t n = 2; std::find(sectionKeys.begin(), sectionKeys.end(), key) != sectionKeys.end(); ++n)
+        key = base + " " + std::to_string(n);
+    sectionKeys.push_back(key);
+    return key;
+}
+
+static void writeField(const char *description, const std::string& value, FieldType type)
+{
+    std::string& data = outputBuffer.get();
+    switch (outputFormat)
+    {
+    case OutputFormat::Text:
+        output << std::setw(width) << std::left << description << value << '\n';
+        break;
+    case OutputFormat::Json:
+        data += (sectionKeys.empty() && !tableHeader) ? "\n" : ",\n";
+        data += "    ";
+        writeEscaped(uniqueKey(trimKey(description)), '"');
+        data += ": ";
+        if (FieldType::String == type)
+            writeEscaped(value, '"');
+        else if (FieldType::Bool == type)
+            data += ("Yes" == value) ? "true" : "false";
+        else
+            data += value;
+        break;
+    case OutputFormat::Csv:
+        writeEscaped(section, '"');
+        data += ',';
+        writeEscaped(uniqueKey(trimKey(description)), '"');
+        data += ',';
+        writeEscaped((FieldType::Bool == type) ? (("Yes" == value) ? "true" : "false") : value, '"');
+        data += '\n';
+        break;
+    case OutputFormat::Prometheus:
+        data += "cpuinfo_" + metricName(section + " " + uniqueKey(trimKey(description)));
+        if (FieldType::String == type)
+        {   // Strings are exposed as info metrics
+            data += "{value=";
+            writeEscaped(value, '"');
+            data += "} 1\n";
+        } else
+            data += " " + ((FieldType::Bool == type) ? std::string(("Yes" == value) ? "1" : "0") : value) + "\n";
+        break;
+    }
+}
+
+template<class Type>
+typename std::enable_if<std::is_arithmetic<Type>::value>::type
+printLn(const char *description, const Type& value)
+{
+    writeField(description, std::to_string(value), FieldType::Number);
+}
+
 template<class Type>
-void printLn(const char *description, const Type& value)
+typename std::enable_if<!std::is_arithmetic<Type>::value>::type
+printLn(const char *description, const Type& value)
 {
-    std::cout << std::setw(width) << std::left << description << value << std::endl;
+    writeField(description, value, FieldType::String);
+}
+
+void printLn(const char *description, Boolean value)
+{
+    writeField(description, value.value ? "Yes" : "No", FieldType::Bool);
 }
 
 void printString(const char *description)
 {
-    std::cout << description << std::endl;
+    if (OutputFormat::Text == outputFormat)
+    {
+        output << description << '\n';
+        return;
+    }
+    // Line ending with colon starts group of fields
+    const std::string line(description);
+    const std::string key = trimKey(description);
+    if (line.find(':') != std::string::npos)
+        group = key;
 }
 
 void printHeading(const char *description)
 {
-    const std::size_t length = strlen(description);
-    std::size_t dashedLength = (80 - length)/2;
-    std::cout << std::endl;
-    for (std::size_t i = 0; i < dashedLength - 1; ++i)
-        std::cout << "=";
-    std::cout << " " << description << " ";
-    if (length % 2)
-        ++dashedLength;
-    for (std::size_t i = 1; i < dashedLength; ++i)
-        std::cout << "=";
-    std::cout << std::endl << std::endl;
+    std::string& data = outputBuffer.get();
+    section = description;
+    group.clear();
+    sectionKeys.clear();
+    switch (outputFormat)
+    {
+    case OutputFormat::Text:
+        {
+            const std::size_t length = strlen(description);
+            std::size_t dashedLength = (80 - length)/2;
+            output << '\n';
+            for (std::size_t i = 0; i < dashedLength - 1; ++i)
+                output << "=";
+            output << " " << description << " ";
+            if (length % 2)
+                ++dashedLength;
+            for (std::size_t i = 1; i < dashedLength; ++i)
+                output << "=";
+            output << "\n\n";
+        }
+        break;
+    case OutputFormat::Json:
+        if (tableHeader)
+            data += "]";
+        data += numSections ? "\n  },\n  " : "{\n  ";
+        writeEscaped(section, '"');
+        data += ": {";
+        break;
+    default:
+        break;
+    }
+    tableHeader = false;
+    ++numSections;
+}
+
+/* Table is the last element of section. Columns have fixed width in text. */
+
+void printTableHeader(const char *name, const std::vector<std::pair<const char *, int>>& columns)
+{
+    std::string& data = outputBuffer.get();
+    tableName = name;
+    tableColumns.clear();
+    tableRow = 0;
+    for (const auto& column: columns)
+        tableColumns.push_back(column.first);
+    if (OutputFormat::Text == outputFormat)
+    {
+        for (const auto& column: columns)
+            output << std::setw(column.second) << std::left << column.first;
+        output << '\n';
+    } else if (OutputFormat::Json == outputFormat)
+    {
+        data += sectionKeys.empty() ? "\n    " : ",\n    ";
+        writeEscaped(tableName, '"');
+        data += ": [";
+        tableHeader = true;
+    }
+}
+
+void printTableRow(const std::vector<std::pair<std::string, int>>& cells)
+{
+    std::string& data = outputBuffer.get();
+    switch (outputFormat)
+    {
+    case OutputFormat::Text:
+        for (const auto& cell: cells)
+            output << std::setw(cell.second) << std::left << cell.first;
+        output << '\n';
+        break;
+    case OutputFormat::Json:
+        data += tableRow ? ",\n      {" : "\n      {";
+        for (size_t i = 0; i < cells.size() && i < tableColumns.size(); ++i)
+        {
+            data += i ? ", " : "";
+            writeEscaped(tableColumns[i], '"');
+            data += ": ";
+            const std::string& cell = cells[i].first;
+            const bool isNumber = !cell.empty() && isdigit((unsigned char)cell.front()) &&
+                isdigit((unsigned char)cell.back()) && (cell.find_first_not_of("0123456789.") == std::string::npos) &&
+                (std::count(cell.begin(), cell.end(), '.') <= 1);
+            if (isNumber)
+                data += cells[i].first;
+            else
+                writeEscaped(cells[i].first, '"');
+        }
+        data += "}";
+        break;
+    case OutputFormat::Csv:
+        for (size_t i = 0; i < cells.size() && i < tableColumns.size(); ++i)
+        {
+            writeEscaped(section, '"');
+            data += ',';
+            writeEscaped(tableName + " " + std::to_string(tableRow) + " " + tableColumns[i], '"');
+            data += ',';
+            writeEscaped(cells[i].first, '"');
+            data += '\n';
+        }
+        break;
+    case OutputFormat::Prometheus:
+        data += "cpuinfo_" + metricName(section + " " + tableName) + "{";
+        for (size_t i = 0; i < cells.size() && i < tableColumns.size(); ++i)
+        {
+            data += (i ? "," : "") + metricName(tableColumns[i]) + "=";
+            writeEscaped(cells[i].first, '"');
+        }
+        data += "} 1\n";
+        break;
+    }
+    ++tableRow;
 }
@@ -0,0 +1,90 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sched.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <thread>
+#include "threadAffinity.h"
+
+uint32_t getLogicalProcessorCount() noexcept
+{
+#ifdef _WIN32
+    return GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#else
+    cpu_set_t cpuSet;
+    if (0 == sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet))
+        return std::max(CPU_COUNT(&cpuSet), 1);
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 1;
+#endif
+}
+
+std::vector<uint32_t> getLogicalProcessors()
+{
+    std::vector<uint32_t> processors;
+#ifndef _WIN32
+    cpu_set_t cpuSet;
+    if (0 == sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet))
+    {   // Allowed set may be sparse under taskset or cpuset
+        for (uint32_t processor = 0; processor < CPU_SETSIZE; ++processor)
+        {
+            if (CPU_ISSET(processor, &cpuSet))
+                processors.push_back(processor);
+        }
+        if (!processors.empty())
+            return processors;
+    }
+#endif // !_WIN32
+    const uint32_t count = getLogicalProcessorCount();
+    for (uint32_t processor = 0; processor < count; ++processor)
+        processors.push_back(processor);
+    return processors;
+}
+
+bool setThreadAffinity(uint32_t processor) noexcept
+{
+#ifdef _WIN32
+    // Find processor group which contains given processor
+    const WORD groupCount = GetActiveProcessorGroupCount();
+    for (WORD group = 0; group < groupCount; ++group)
+    {
+        const DWORD count = GetActiveProcessorCount(group);
+        if (processor < count)
+        {
+            GROUP_AFFINITY affinity = {};
+            affinity.Group = group;
+            affinity.Mask = (KAFFINITY)1 << processor;
+            return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != FALSE;
+        }
+        processor -= count;
+    }
+    return false;
+#else
+    if (processor >= CPU_SETSIZE)
+        return false;
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(processor, &cpuSet);
+    return 0 == sched_setaffinity(0, sizeof(cpu_set_t), &cpuSet);
+#endif // _WIN32
+}
+
+void runOnEachProcessor(const std::function<void(uint32_t processor, bool pinned)>& fn)
+{
+    const std::vector<uint32_t> processors = getLogicalProcessors();
+    std::vector<std::thread> workers;
+    workers.reserve(processors.size());
+    for (uint32_t processor: processors)
+    {
+        workers.emplace_back([&fn, processor]()
+        {
+            const bool pinned = setThreadAffinity(processor);
+            fn(processor, pinned);
+        });
+    }
+    for (auto& worker: workers)
+        worker.join();
+}
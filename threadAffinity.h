@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/* Logical processors the process is allowed to run on. Linux keeps ids
+   of the affinity mask, which may be sparse under taskset or cpuset.
+   On Windows processors are numbered contiguously from zero and the
+   numbering spans all processor groups. Ids are in ascending order. */
+
+uint32_t getLogicalProcessorCount() noexcept;
+std::vector<uint32_t> getLogicalProcessors();
+bool setThreadAffinity(uint32_t processor) noexcept;
+
+/* Runs function on each allowed logical processor in parallel: one short-lived
+   worker thread is pinned to every processor and all of them are joined
+   before return. Function receives false if worker couldn't be pinned. */
+
+void runOnEachProcessor(const std::function<void(uint32_t processor, bool pinned)>& fn);
@@ -0,0 +1,42 @@
+#include <mutex>
+#include <stdexcept>
+#include "tscClock.h"
+#include "cpuInfox86.h"
+#include "cpuid.h"
+
+#define RDTSCP_BIT  (1 << 27)
+
+constexpr bool TscClock::is_steady;
+constexpr uint32_t TscClock::shift;
+uint64_t TscClock::frequency = 0ull;
+uint64_t TscClock::multiplier = 0ull;
+bool TscClock::rdtscp = false;
+
+static std::once_flag calibrationFlag;
+
+TscClock::TscClock()
+{
+    const x86ProcessorInfo& cpuInfo = queryProcessorInfo(x86SectionFeatures);
+    if (!cpuInfo.features.timestampCounter || !cpuInfo.apmFeatures.invariantTimestampCounter)
+        throw std::runtime_error("invariant time stamp counter is not supported");
+    std::call_once(calibrationFlag,
+        []()
+        {
+            const x86TscFrequency tsc = getTscFrequency();
+            if (!tsc.frequency)
+                return;
+            // ns = ticks * (10^9 * 2^shift/frequency) >> shift
+            const uint64_t second = 1000000000ull;
+            frequency = tsc.frequency;
+            multiplier = (uint64_t)(((double)second * (1ull << shift))/tsc.frequency + 0.5);
+            CpuId cpuId;
+            __cpuid(&cpuId.eax, CPUID_EXTENDED_ID);
+            if ((uint32_t)cpuId.eax >= CPUID_EXTENDED_ID + 0x1)
+            {
+                __cpuid(&cpuId.eax, CPUID_EXTENDED_ID + 0x1);
+                rdtscp = (cpuId.edx & RDTSCP_BIT) != 0;
+            }
+        });
+    if (!frequency)
+        throw std::runtime_error("failed to calibrate time stamp counter");
+}
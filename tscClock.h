@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+/* std::chrono compatible clock which reads invariant time stamp counter
+   directly. Ticks are converted to nanoseconds with multiply and shift
+   by fixed-point factor derived from getTscFrequency(). Constructor
+   performs calibration and throws std::runtime_error if TSC isn't
+   invariant; now() must not be used before clock has been constructed. */
+
+class TscClock
+{
+public:
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<TscClock> time_point;
+    static constexpr bool is_steady = true;
+
+    TscClock();
+
+    // RDTSC may be executed before preceding instructions complete
+    static time_point now() noexcept
+    {
+        return time_point(duration(toNanoseconds(__rdtsc())));
+    }
+
+    // LFENCE waits until all preceding instructions complete locally
+    static time_point nowFenced() noexcept
+    {
+        _mm_lfence();
+        return time_point(duration(toNanoseconds(__rdtsc())));
+    }
+
+    // RDTSCP waits for preceding instructions, LFENCE holds the following ones.
+    // Processors without RDTSCP surround RDTSC with fences instead.
+    static time_point nowSerialized() noexcept
+    {
+        uint64_t ticks;
+        if (rdtscp)
+        {
+            unsigned int aux;
+            ticks = __rdtscp(&aux);
+        } else
+        {
+            _mm_lfence();
+            ticks = __rdtsc();
+        }
+        _mm_lfence();
+        return time_point(duration(toNanoseconds(ticks)));
+    }
+
+    static rep toNanoseconds(uint64_t ticks) noexcept
+    {
+    #ifdef _MSC_VER
+        uint64_t high;
+        const uint64_t low = _umul128(ticks, multiplier, &high);
+        return (rep)__shiftright128(low, high, shift);
+    #else
+        return (rep)(((unsigned __int128)ticks * multiplier) >> shift);
+    #endif
+    }
+
+    static uint64_t getFrequency() noexcept { return frequency; }
+    static bool hasRdtscp() noexcept { return rdtscp; }
+
+private:
+    static constexpr uint32_t shift = 32;
+    static uint64_t frequency;
+    static uint64_t multiplier;
+    static bool rdtscp;
+};